@@ -4,13 +4,15 @@ file: stat* EOF;
 
 stat: exp '=' exp #assignstat
     | exp op=('+='|'-='|'*='|'/=') exp #compassignstat
-    | exp '.' ID '(' explist ')' #membercallstat
-    | ID '(' explist ')' #funccallstat
+    | exp '.' ID '(' explist? ')' #membercallstat
+    | ID '(' explist? ')' #funccallstat
     | 'if' exp stat ('else if' exp stat)* ('else' els=stat)? #condstat
     | '{' stat* '}' #blockstat
     | 'while' exp stat #whilestat
     | 'for' ID 'in' exp stat #forstat
     | 'return' exp? #returnstat
+    | 'yield' exp #yieldstat
+    | 'import' STRING ('as' ID)? #importstat
     ;
 
 exp
@@ -40,11 +40,19 @@ public:
         return stat(new BlockStat(s), ctx);
     }
 
+    // Names function definition e after the variable or member it is assigned to
+    static void nameFunction(expp e, expp target) {
+        auto f = dynamic_pointer_cast<FuncDefExp>(e);
+        if (!f) return;
+        if (auto id = dynamic_pointer_cast<IdExp>(target)) f->name = id->name;
+        else if (auto m = dynamic_pointer_cast<MemberExp>(target)) f->name = m->member;
+    }
+
     virtual antlrcpp::Any visitAssignstat(ASParser::AssignstatContext *ctx) override {
-        return stat(new AssignStat(
-            visit(ctx->exp(0)).as<expp>(),
-            visit(ctx->exp(1)).as<expp>()
-        ), ctx);
+        expp l = visit(ctx->exp(0)).as<expp>();
+        expp r = visit(ctx->exp(1)).as<expp>();
+        nameFunction(r, l);
+        return stat(new AssignStat(l, r), ctx);
     }
 
     virtual antlrcpp::Any visitCompassignstat(ASParser::CompassignstatContext *ctx) override {
@@ -106,6 +114,24 @@ public:
         return stat(new ReturnStat(ret), ctx);
     }
 
+    virtual antlrcpp::Any visitYieldstat(ASParser::YieldstatContext *ctx) override {
+        return stat(new YieldStat(visit(ctx->exp())), ctx);
+    }
+
+    virtual antlrcpp::Any visitImportstat(ASParser::ImportstatContext *ctx) override {
+        auto str = ctx->STRING()->getText();
+        auto path = str.substr(1, str.length()-2);
+        string name;
+        if (ctx->ID()) name = ctx->ID()->getText();
+        else {
+            // default name is the file name without directory and extension
+            auto slash = path.find_last_of('/');
+            name = path.substr(slash == string::npos ? 0 : slash+1);
+            name = name.substr(0, name.find('.'));
+        }
+        return stat(new ImportStat(path, name), ctx);
+    }
+
     virtual antlrcpp::Any visitIdexp(ASParser::IdexpContext *ctx) override {
         return exp(new IdExp(ctx->ID()->getText()), ctx);
     }
@@ -125,16 +151,20 @@ public:
         return exp(new FloatExp(v), ctx);
     }
     virtual antlrcpp::Any visitFunccallstat(ASParser::FunccallstatContext *ctx) override {
-        return stat(new FuncCallStat(nullptr, ctx->ID()->getText(), visit(ctx->explist())), ctx);
+        expl args = (ctx->explist())?visit(ctx->explist()).as<expl>():expl();
+        return stat(new FuncCallStat(nullptr, ctx->ID()->getText(), args), ctx);
     }
     virtual antlrcpp::Any visitMembercallstat(ASParser::MembercallstatContext *ctx) override {
-        return stat(new FuncCallStat(visit(ctx->exp()), ctx->ID()->getText(), visit(ctx->explist())), ctx);
+        expl args = (ctx->explist())?visit(ctx->explist()).as<expl>():expl();
+        return stat(new FuncCallStat(visit(ctx->exp()), ctx->ID()->getText(), args), ctx);
     }
 
     virtual antlrcpp::Any visitMapdef(ASParser::MapdefContext *ctx) override {
         map<string, expp> v;
         for (int i=0;i<ctx->ID().size();i++) {
-            v[ctx->ID(i)->getText()] = visit(ctx->exp(i));
+            expp e = visit(ctx->exp(i)).as<expp>();
+            if (auto f = dynamic_pointer_cast<FuncDefExp>(e)) f->name = ctx->ID(i)->getText();
+            v[ctx->ID(i)->getText()] = e;
         }
         return exp(new MapDefExp(v), ctx);
     }
@@ -176,10 +206,10 @@ public:
         UNOP;
     }
     virtual antlrcpp::Any visitAndexp(ASParser::AndexpContext *ctx) override {
-        BINOP;
+        return exp(new AndExp(visit(ctx->exp(0)), visit(ctx->exp(1))), ctx);
     }
     virtual antlrcpp::Any visitOrexp(ASParser::OrexpContext *ctx) override {
-        BINOP;
+        return exp(new OrExp(visit(ctx->exp(0)), visit(ctx->exp(1))), ctx);
     }
     virtual antlrcpp::Any visitAdditiveexp(ASParser::AdditiveexpContext *ctx) override {
         BINOP;
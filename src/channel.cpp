@@ -0,0 +1,233 @@
+#include <ascript/script.h>
+#include <algorithm>
+#include <thread>
+
+using namespace std;
+
+// Attempts at receiving before sleeping
+static const int SPINS = 1000;
+
+// Copies v into m, path holds the containers being copied to detect cycles
+static void copyOut(const valp& v, Message& m, vector<Value*>& path) {
+    if (auto x = dynamic_pointer_cast<ValueExternBase>(v)) {
+        copyOut(x->get(), m, path);
+    } else if (!v || dynamic_pointer_cast<ValueNone>(v)) {
+        m.kind = Message::None;
+    } else if (auto x = dynamic_pointer_cast<ValueInt>(v)) {
+        m.kind = Message::Int;
+        m.i = x->value;
+    } else if (auto x = dynamic_pointer_cast<ValueFloat>(v)) {
+        m.kind = Message::Float;
+        m.f = x->value;
+    } else if (auto x = dynamic_pointer_cast<ValueStr>(v)) {
+        m.kind = Message::Str;
+        if (x->bytesOwner()) {
+            m.owner = x->bytesOwner();
+            m.view = x->view();
+        } else {
+            m.text = x->view();
+        }
+    } else if (auto x = dynamic_pointer_cast<ValueVec>(v)) {
+        m.kind = Message::Vec;
+        m.floats.assign(x->v, x->v + x->n);
+    } else if (auto x = dynamic_pointer_cast<ValueMat>(v)) {
+        m.kind = Message::Mat;
+        m.floats.assign(x->m, x->m + 16);
+    } else if (auto x = dynamic_pointer_cast<ValueRange>(v)) {
+        m.kind = Message::Range;
+        m.range[0] = x->beg;
+        m.range[1] = x->end;
+        m.range[2] = x->step;
+    } else if (dynamic_pointer_cast<ValueModule>(v)) {
+        throw runtime_error("Can't send module");
+    } else if (dynamic_pointer_cast<ValueList>(v) || dynamic_pointer_cast<ValueMap>(v)) {
+        if (find(path.begin(), path.end(), v.get()) != path.end()) throw runtime_error("Can't send cyclic value");
+        path.push_back(v.get());
+        auto x = dynamic_pointer_cast<ValueList>(v);
+        if (x && x->isSparse()) {
+            m.kind = Message::SparseList;
+            m.length = x->size();
+            m.indices = x->indices();
+            m.items.resize(m.indices.size());
+            for (size_t i=0;i<m.indices.size();i++) copyOut((*x)[m.indices[i]], m.items[i], path);
+        } else if (x) {
+            m.kind = Message::List;
+            m.items.resize(x->size());
+            for (size_t i=0;i<x->size();i++) copyOut((*x)[i], m.items[i], path);
+        } else {
+            auto y = dynamic_pointer_cast<ValueMap>(v);
+            m.kind = Message::Map;
+            m.items.resize(y->vars.size());
+            size_t i = 0;
+            for (auto& e : y->vars) {
+                m.keys.push_back(e.first);
+                copyOut(e.second, m.items[i++], path);
+            }
+        }
+        path.pop_back();
+    } else if (dynamic_pointer_cast<ValueFunction>(v) || dynamic_pointer_cast<ValueNativeFunc>(v)) {
+        throw runtime_error("Can't send function");
+    } else throw runtime_error("Can't send value " + v->print());
+}
+
+// Builds the values of m, taking its bytes
+static valp copyIn(Message& m) {
+    switch (m.kind) {
+    case Message::None: return valp(new ValueNone());
+    case Message::Int: return valp(new ValueInt(m.i));
+    case Message::Float: return valp(new ValueFloat(m.f));
+    case Message::Str:
+        if (m.owner) return valp(new ValueStr(m.owner, m.view.data(), m.view.size()));
+        return valp(new ValueStr(move(m.text)));
+    case Message::List: {
+        vallist items;
+        items.reserve(m.items.size());
+        for (auto& i : m.items) items.push_back(copyIn(i));
+        return valp(new ValueList(move(items)));
+    }
+    case Message::SparseList: {
+        auto r = new ValueList({});
+        valp result(r);
+        r->resizeSparse(m.length);
+        for (size_t i=0;i<m.indices.size();i++) r->atRef(m.indices[i]) = copyIn(m.items[i]);
+        return result;
+    }
+    case Message::Map: {
+        auto r = new ValueMap({});
+        valp result(r);
+        for (size_t i=0;i<m.keys.size();i++) r->vars[m.keys[i]] = copyIn(m.items[i]);
+        return result;
+    }
+    case Message::Vec: {
+        auto r = new ValueVec(m.floats.size());
+        copy(m.floats.begin(), m.floats.end(), r->v);
+        return valp(r);
+    }
+    case Message::Mat: {
+        auto r = new ValueMat();
+        copy(m.floats.begin(), m.floats.end(), r->m);
+        return valp(r);
+    }
+    case Message::Range: return valp(new ValueRange(m.range[0], m.range[1], m.range[2]));
+    }
+    throw runtime_error("Corrupted message");
+}
+
+Channel::Channel(size_t capacity) {
+    size_t n = 1;
+    while (n < capacity) n *= 2;
+    slots.reset(new Slot[n]);
+    for (size_t i=0;i<n;i++) slots[i].seq.store(i, memory_order_relaxed);
+    mask = n-1;
+}
+
+// Bounded queue of Dmitry Vyukov: senders reserve a position by moving head,
+// the slot sequence tells whether it is free, written or still being read
+// (https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue)
+bool Channel::push(Message& m) {
+    size_t pos = head.load(memory_order_relaxed);
+    Slot* s;
+    while (true) {
+        s = &slots[pos & mask];
+        size_t seq = s->seq.load(memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (head.compare_exchange_weak(pos, pos+1, memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            // the slot of the previous round isn't read yet
+            return false;
+        } else {
+            pos = head.load(memory_order_relaxed);
+        }
+    }
+    s->message = move(m);
+    s->seq.store(pos+1, memory_order_release);
+    // wake receivers that may have missed the value
+    atomic_thread_fence(memory_order_seq_cst);
+    if (sleepers.load(memory_order_relaxed)) {
+        lock_guard<mutex> lock(sleepMutex);
+        wake.notify_all();
+    }
+    return true;
+}
+
+// Marks the channel as received from by this thread while alive, pop is
+// single consumer
+struct ReceiverGuard {
+    ReceiverGuard(Channel& c) : c(c) {
+        if (c.receiving.exchange(true, memory_order_acquire)) throw runtime_error("Channel already has a receiver");
+    }
+    ~ReceiverGuard() {
+        c.receiving.store(false, memory_order_release);
+    }
+    Channel& c;
+};
+
+bool Channel::pop(Message& m) {
+    size_t pos = tail.load(memory_order_relaxed);
+    auto& s = slots[pos & mask];
+    if (s.seq.load(memory_order_acquire) != pos+1) return false;
+    m = move(s.message);
+    s.message = Message();
+    s.seq.store(pos + mask + 1, memory_order_release);
+    tail.store(pos+1, memory_order_relaxed);
+    return true;
+}
+
+void Channel::send(const valp& v) {
+    Message m;
+    vector<Value*> path;
+    copyOut(v, m, path);
+    while (!push(m)) this_thread::yield();
+}
+
+bool Channel::trySend(const valp& v) {
+    Message m;
+    vector<Value*> path;
+    copyOut(v, m, path);
+    return push(m);
+}
+
+valp Channel::receive() {
+    ReceiverGuard guard(*this);
+    Message m;
+    for (int i=0;i<SPINS;i++) {
+        if (pop(m)) return copyIn(m);
+    }
+    {
+        unique_lock<mutex> lock(sleepMutex);
+        sleepers.fetch_add(1);
+        wake.wait(lock, [&] { return pop(m); });
+        sleepers.fetch_sub(1);
+    }
+    return copyIn(m);
+}
+
+valp Channel::tryReceive() {
+    ReceiverGuard guard(*this);
+    Message m;
+    if (!pop(m)) return nullptr;
+    return copyIn(m);
+}
+
+valp ValueChannel::call(string f, vector<valp> args) {
+    if (f == "send" && args.size() == 1) {
+        channel->send(args[0]);
+        return valp(new ValueNone());
+    }
+    if (f == "trySend" && args.size() == 1) {
+        return valp(new ValueInt(channel->trySend(args[0])));
+    }
+    if (f == "receive" && args.size() == 0) {
+        return channel->receive();
+    }
+    if (f == "tryReceive" && args.size() == 0) {
+        auto v = channel->tryReceive();
+        return v ? v : valp(new ValueNone());
+    }
+    throw runtime_error("Unknown method");
+}
+
+string ValueChannel::print() {
+    return "channel";
+}
@@ -0,0 +1,432 @@
+#include <ascript/script.h>
+
+using namespace std;
+
+// Closure engine: every AST node is converted once into a closure with its
+// children already compiled, so running it needs no node type tests.
+// Errors are reported on the same nodes as with the tree engine.
+
+// Values referring to outside references evaluate to the value of these refs
+static valp unwrapExtern(const valp& v) {
+    if (auto vv = dynamic_pointer_cast<ValueExternBase>(v)) return vv->get();
+    return v;
+}
+
+Script::StatFn Script::compile(statp sp) {
+    auto info = sp->srcinfo;
+    if (auto s = dynamic_pointer_cast<AssignStat>(sp)) {
+        auto right = compile(s->right);
+        auto left = compileRef(s->left);
+        return [=](const valp& vars) {
+            account->stats.statements++;
+            auto r = right(vars);
+            auto& v = left(vars);
+            try {
+                // Specialization for extern values
+                if (auto vv = dynamic_pointer_cast<ValueExternBase>(v)) vv->assign(r);
+                else v = r;
+            } catch (runtime_error e) {
+                throw error(info, e.what());
+            }
+        };
+    }
+    else if (auto s = dynamic_pointer_cast<CompAssignStat>(sp)) {
+        auto right = compile(s->right);
+        auto left = compileRef(s->left);
+        string op(1, s->op[0]);
+        return [=](const valp& vars) {
+            account->stats.statements++;
+            auto r = right(vars);
+            auto& v = left(vars);
+            try {
+                if (auto vv = dynamic_pointer_cast<ValueExternBase>(v)) vv->assign(vv->get()->binop(op, r));
+                else if (!v) throw runtime_error("Index is a hole");
+                else v = v->binop(op, r);
+            } catch (runtime_error e) {
+                throw error(info, e.what());
+            }
+        };
+    }
+    else if (auto s = dynamic_pointer_cast<FuncCallStat>(sp)) {
+        expp fce = expp(new FuncCallExp(s->ctx, s->f, s->a));
+        fce->srcinfo = info;
+        auto call = compile(fce);
+        return [=](const valp& vars) {
+            account->stats.statements++;
+            call(vars);
+        };
+    }
+    else if (auto s = dynamic_pointer_cast<IfStat>(sp)) {
+        auto cond = compile(s->cond);
+        auto then = compile(s->then);
+        auto els = compile(s->els);
+        return [=](const valp& vars) {
+            account->stats.statements++;
+            auto vi = cond(vars);
+            bool t;
+            try {
+                t = vi->isTrue();
+            } catch (runtime_error e) {
+                throw error(info, e.what());
+            }
+            if (t) then(vars);
+            else els(vars);
+        };
+    }
+    else if (auto s = dynamic_pointer_cast<BlockStat>(sp)) {
+        vector<StatFn> stats;
+        for (auto ss : s->stats) stats.push_back(compile(ss));
+        return [=](const valp& vars) {
+            account->stats.statements++;
+            for (auto& ss : stats) {
+                ss(vars);
+                // stop block if return stat executed
+                if (ret) return;
+            }
+        };
+    }
+    else if (auto s = dynamic_pointer_cast<WhileStat>(sp)) {
+        auto cond = compile(s->cond);
+        auto stat = compile(s->stat);
+        return [=](const valp& vars) {
+            account->stats.statements++;
+            while (true) {
+                auto vi = cond(vars);
+                bool t;
+                try {
+                    t = vi->isTrue();
+                } catch (runtime_error e) {
+                    throw error(info, e.what());
+                }
+                if (!t) break;
+                stat(vars);
+                // stop loop if return stat executed
+                if (ret) return;
+            }
+        };
+    }
+    else if (auto s = dynamic_pointer_cast<ForStat>(sp)) {
+        auto list = compile(s->list);
+        auto stat = compile(s->stat);
+        string id = s->id;
+        return [=](const valp& vars) {
+            account->stats.statements++;
+            auto l = list(vars);
+            iterp it;
+            try {
+                it = l->iter();
+            } catch (runtime_error e) {
+                throw error(info, e.what());
+            }
+            while (true) {
+                valp v;
+                try {
+                    v = it->next();
+                } catch (runtime_error e) {
+                    throw error(info, e.what());
+                }
+                if (!v) break;
+                vars->getRef(id) = v;
+                stat(vars);
+                // stop loop if return stat executed
+                if (ret) return;
+            }
+        };
+    }
+    else if (auto s = dynamic_pointer_cast<ReturnStat>(sp)) {
+        if (auto call = dynamic_pointer_cast<FuncCallExp>(s->e)) {
+            // `return f(...)` inside a function, the call may reuse the current frame
+            auto e = compile(s->e);
+            vector<ExpFn> args;
+            for (auto a : call->a) args.push_back(compile(a));
+            ExpFn ctx = call->ctx ? compile(call->ctx) : nullptr;
+            return [=](const valp& vars) {
+                account->stats.statements++;
+                if (depth == 0) {
+                    ret = e(vars);
+                    return;
+                }
+                vector<valp> a;
+                for (auto& af : args) a.push_back(af(vars));
+                valp vctx = ctx ? ctx(vars) : nullptr;
+                try {
+                    ret = callWithArgs(vars, *call, vctx, a, true);
+                } catch (runtime_error e2) {
+                    throw error(call->srcinfo, e2.what());
+                }
+                if (!ret) ret = valp(new ValueNone());
+            };
+        }
+        if (s->e) {
+            auto e = compile(s->e);
+            return [=](const valp& vars) {
+                account->stats.statements++;
+                ret = e(vars);
+            };
+        }
+        return [=](const valp& vars) {
+            account->stats.statements++;
+            ret = valp(new ValueNone());
+        };
+    }
+    else if (auto s = dynamic_pointer_cast<YieldStat>(sp)) {
+        auto e = compile(s->e);
+        return [=](const valp& vars) {
+            account->stats.statements++;
+            auto v = e(vars);
+            try {
+                yield(v);
+            } catch (runtime_error e) {
+                throw error(info, e.what());
+            }
+        };
+    }
+    else if (auto s = dynamic_pointer_cast<ImportStat>(sp)) {
+        string path = s->path;
+        string name = s->name;
+        return [=](const valp& vars) {
+            account->stats.statements++;
+            try {
+                vars->getRef(name) = import(path);
+            } catch (runtime_error e) {
+                throw error(info, e.what());
+            }
+        };
+    }
+    return [=](const valp& vars) {
+        account->stats.statements++;
+        throw error(info, "Unknown statement");
+    };
+}
+
+Script::ExpFn Script::compile(expp ep) {
+    auto info = ep->srcinfo;
+    if (auto e = dynamic_pointer_cast<IntExp>(ep)) {
+        int v = e->value;
+        return [=](const valp& vars) {
+            return valp(new ValueInt(v));
+        };
+    }
+    else if (auto e = dynamic_pointer_cast<FloatExp>(ep)) {
+        float v = e->value;
+        return [=](const valp& vars) {
+            return valp(new ValueFloat(v));
+        };
+    }
+    else if (auto e = dynamic_pointer_cast<IdExp>(ep)) {
+        string name = e->name;
+        return [=](const valp& vars) {
+            return unwrapExtern(vars->getRef(name));
+        };
+    }
+    else if (auto e = dynamic_pointer_cast<BinOpExp>(ep)) {
+        auto l = compile(e->l);
+        auto r = compile(e->r);
+        string op = e->op;
+        return [=](const valp& vars) {
+            auto v1 = l(vars);
+            auto v2 = r(vars);
+            try {
+                return v1->binop(op, v2);
+            } catch (runtime_error e) {
+                throw error(info, e.what());
+            }
+        };
+    }
+    else if (auto e = dynamic_pointer_cast<UnOpExp>(ep)) {
+        auto l = compile(e->l);
+        string op = e->op;
+        return [=](const valp& vars) {
+            auto v1 = l(vars);
+            try {
+                return v1->unop(op);
+            } catch (runtime_error e) {
+                throw error(info, e.what());
+            }
+        };
+    }
+    else if (auto e = dynamic_pointer_cast<MapDefExp>(ep)) {
+        vector<pair<string, ExpFn>> values;
+        for (auto f : e->values) values.push_back({f.first, compile(f.second)});
+        return [=](const valp& vars) {
+            auto m = new ValueMap({});
+            valp mp(m);
+            for (auto& f : values) {
+                m->getRef(f.first) = f.second(vars);
+            }
+            return mp;
+        };
+    }
+    else if (auto e = dynamic_pointer_cast<ListDefExp>(ep)) {
+        vector<ExpFn> values;
+        for (auto v : e->values) values.push_back(compile(v));
+        return [=](const valp& vars) {
+            auto m = new ValueList({});
+            valp mp(m);
+            auto& elements = m->values();
+            elements.reserve(values.size());
+            for (auto& v : values) {
+                elements.push_back(v(vars));
+            }
+            return mp;
+        };
+    }
+    else if (auto e = dynamic_pointer_cast<RangeDefExp>(ep)) {
+        auto beg = compile(e->beg);
+        auto end = compile(e->end);
+        auto step = compile(e->step);
+        return [=](const valp& vars) {
+            auto b = beg(vars);
+            auto en = end(vars);
+            auto s = step(vars);
+            try {
+                return valp(new ValueRange(b->getInt(), en->getInt(), s->getInt()));
+            } catch (runtime_error e) {
+                throw error(info, e.what());
+            }
+        };
+    }
+    else if (auto e = dynamic_pointer_cast<FuncCallExp>(ep)) {
+        vector<ExpFn> args;
+        for (auto a : e->a) args.push_back(compile(a));
+        ExpFn ctx = e->ctx ? compile(e->ctx) : nullptr;
+        return [=](const valp& vars) {
+            vector<valp> a;
+            a.reserve(args.size());
+            for (auto& af : args) a.push_back(af(vars));
+            valp vctx = ctx ? ctx(vars) : nullptr;
+            try {
+                return unwrapExtern(callWithArgs(vars, *e, vctx, a, false));
+            } catch (runtime_error e2) {
+                throw error(info, e2.what());
+            }
+        };
+    }
+    else if (auto e = dynamic_pointer_cast<StrExp>(ep)) {
+        string v = e->v;
+        return [=](const valp& vars) {
+            return valp(new ValueStr(v));
+        };
+    }
+    else if (auto e = dynamic_pointer_cast<TernaryExp>(ep)) {
+        auto cond = compile(e->cond);
+        auto then = compile(e->then);
+        auto els = compile(e->els);
+        return [=](const valp& vars) {
+            auto vcond = cond(vars);
+            bool t;
+            try {
+                t = vcond->isTrue();
+            } catch (runtime_error e) {
+                throw error(info, e.what());
+            }
+            return t ? then(vars) : els(vars);
+        };
+    }
+    else if (auto e = dynamic_pointer_cast<AndExp>(ep)) {
+        auto l = compile(e->l);
+        auto r = compile(e->r);
+        return [=](const valp& vars) {
+            auto lv = l(vars);
+            bool t;
+            try {
+                t = lv->isTrue();
+            } catch (runtime_error e) {
+                throw error(info, e.what());
+            }
+            return t ? r(vars) : lv;
+        };
+    }
+    else if (auto e = dynamic_pointer_cast<OrExp>(ep)) {
+        auto l = compile(e->l);
+        auto r = compile(e->r);
+        return [=](const valp& vars) {
+            auto lv = l(vars);
+            bool t;
+            try {
+                t = lv->isTrue();
+            } catch (runtime_error e) {
+                throw error(info, e.what());
+            }
+            return t ? lv : r(vars);
+        };
+    }
+    else if (auto e = dynamic_pointer_cast<FuncDefExp>(ep)) {
+        auto args = e->args;
+        auto body = e->body;
+        auto name = e->name;
+        auto native = e->native;
+        return [=](const valp& vars) {
+            return makeFunction(args, body, name, native);
+        };
+    }
+    else if (auto e = dynamic_pointer_cast<IndexExp>(ep)) {
+        auto l = compile(e->l);
+        auto i = compile(e->i);
+        return [=](const valp& vars) {
+            auto lv = l(vars);
+            auto iv = i(vars);
+            try {
+                return unwrapExtern(lv->at(iv->getInt()));
+            } catch (runtime_error e) {
+                throw error(info, e.what());
+            }
+        };
+    }
+    else if (auto e = dynamic_pointer_cast<MemberExp>(ep)) {
+        auto l = compile(e->l);
+        string member = e->member;
+        return [=](const valp& vars) {
+            auto lv = l(vars);
+            try {
+                return unwrapExtern(lv->get(member));
+            } catch (runtime_error e) {
+                throw error(info, e.what());
+            }
+        };
+    }
+    return [=](const valp& vars) -> valp {
+        throw error(info, "Unknown statement");
+    };
+}
+
+// References to values for assignment
+Script::RefFn Script::compileRef(expp lp) {
+    auto info = lp->srcinfo;
+    if (auto l = dynamic_pointer_cast<IdExp>(lp)) {
+        string name = l->name;
+        return [=](const valp& vars) -> valp& {
+            return vars->getRef(name);
+        };
+    }
+    else if (auto l = dynamic_pointer_cast<IndexExp>(lp)) {
+        auto lref = compileRef(l->l);
+        auto i = compile(l->i);
+        return [=](const valp& vars) -> valp& {
+            valp l0 = lref(vars);
+            auto iv = i(vars);
+            try {
+                if (!l0) throw runtime_error("Index is a hole");
+                return l0->atRef(iv->getInt());
+            } catch (runtime_error e) {
+                throw error(info, e.what());
+            }
+        };
+    }
+    else if (auto l = dynamic_pointer_cast<MemberExp>(lp)) {
+        auto lref = compileRef(l->l);
+        string member = l->member;
+        return [=](const valp& vars) -> valp& {
+            valp l0 = lref(vars);
+            try {
+                if (!l0) throw runtime_error("Index is a hole");
+                return l0->getRef(member);
+            } catch (runtime_error e) {
+                throw error(info, e.what());
+            }
+        };
+    }
+    return [=](const valp& vars) -> valp& {
+        throw error(info, "Can't get ref from this exp");
+    };
+}
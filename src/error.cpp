@@ -1,36 +1,63 @@
 #include <ascript/script.h>
 #include <string>
 #include <sstream>
+#include <cstring>
 
 using namespace std;
 
-string getLine(string str, int n) {
-    stringstream ss(str);
-    int lineNum = 1;
-    string line;
-    while (std::getline(ss, line) && lineNum < n) lineNum++;
-    return line;
+Source::Source(string filename, string text) : filename(move(filename)), text(move(text)) {
+    lineStarts.push_back(0);
+    const char* s = this->text.data();
+    const char* end = s + this->text.size();
+    while (auto nl = (const char*)memchr(s, '\n', end - s)) {
+        s = nl + 1;
+        lineStarts.push_back(s - this->text.data());
+    }
 }
 
-InterpreterError::InterpreterError(string filename, string source, SourceInfo srcinfo, const string &str) {
-    stringstream ss;
-    ss << filename << ":";
-    if (srcinfo.line != -1) ss << srcinfo.line << ":" << srcinfo.column << ":";
-    ss << "error: " << str << endl;
-    if (srcinfo.line != -1) {
-        auto line = getLine(source, srcinfo.line);
-        ss << line << endl;
-        for (int i=1;i<srcinfo.column;i++) ss << " ";
-        ss << "^";
-        int tildelen = srcinfo.end_index-srcinfo.start_index;
-        int maxlen = line.length()-srcinfo.column;
-        if (tildelen > maxlen) tildelen = maxlen;
-        for (int i=0;i<tildelen;i++) ss << "~";
-        ss << endl; 
-    }
-    this->str = ss.str();
+string_view Source::line(size_t n) const {
+    if (n < 1 || n > lineStarts.size()) return {};
+    size_t beg = lineStarts[n-1];
+    size_t end = n < lineStarts.size() ? lineStarts[n] - 1 : text.size();
+    return string_view(text).substr(beg, end - beg);
 }
 
+InterpreterError::InterpreterError(shared_ptr<const Source> source, SourceInfo srcinfo, string message)
+    : source(move(source)), srcinfo(srcinfo), msg(move(message)) {}
+
 const char* InterpreterError::what() const noexcept {
+    if (!str.empty()) return str.c_str();
+    try {
+        stringstream ss;
+        ss << source->filename << ":";
+        if (srcinfo.line != -1) ss << srcinfo.line << ":" << srcinfo.column << ":";
+        ss << "error: " << msg << endl;
+        if (srcinfo.line != -1) {
+            auto line = source->line(srcinfo.line);
+            ss << line << endl;
+            for (int i=0;i<srcinfo.column;i++) ss << " ";
+            ss << "^";
+            int tildelen = srcinfo.end_index-srcinfo.start_index;
+            int maxlen = line.length()-srcinfo.column;
+            if (tildelen > maxlen) tildelen = maxlen;
+            for (int i=0;i<tildelen;i++) ss << "~";
+            ss << endl;
+        }
+        str = ss.str();
+    } catch (...) {
+        return msg.c_str();
+    }
+    return str.c_str();
+}
+
+LoadError::LoadError(vector<InterpreterError> errors) : list(move(errors)) {}
+
+const char* LoadError::what() const noexcept {
+    if (!str.empty()) return str.c_str();
+    try {
+        for (auto& e : list) str += e.what();
+    } catch (...) {
+        return "syntax errors";
+    }
     return str.c_str();
-}
\ No newline at end of file
+}
@@ -0,0 +1,154 @@
+#include <ascript/script.h>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Bytes read from a file at once, elements longer than this grow the block
+static const size_t BLOCK_SIZE = 1 << 20;
+
+struct FileIterator : public Iterator {
+    FileIterator(string path, size_t recordSize) : recordSize(recordSize) {
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw runtime_error("Can't open file " + path);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    ~FileIterator() {
+        close(fd);
+    }
+
+    virtual valp next() {
+        while (true) {
+            const char* b = block.get() + pos;
+            size_t avail = end - pos;
+            if (recordSize) {
+                if (avail >= recordSize || (eof && avail > 0)) {
+                    return element(b, min(avail, recordSize), min(avail, recordSize));
+                }
+            } else {
+                // no block before the first fill
+                auto nl = avail ? (const char*)memchr(b, '\n', avail) : nullptr;
+                if (nl) return element(b, nl-b, nl-b+1);
+                // last line without newline
+                if (eof && avail > 0) return element(b, avail, avail);
+            }
+            if (eof) return nullptr;
+            fill();
+        }
+    }
+
+private:
+    // String viewing size bytes at b, skips len bytes
+    valp element(const char* b, size_t size, size_t len) {
+        pos += len;
+        return valp(new ValueStr(block, b, size));
+    }
+
+    // Reads next bytes after the unfinished element, which moves to the block start
+    void fill() {
+        size_t rest = end - pos;
+        size_t size = max(BLOCK_SIZE, rest * 2);
+        if (block.use_count() == 1 && size == capacity) {
+            // no element refers to the block anymore
+            memmove(block.get(), block.get() + pos, rest);
+        } else {
+            // counted in the script heap while an element refers to it
+            shared_ptr<char> b((char*)heapAlloc(size), [size](char* p) { heapFree(p, size); }, HeapAllocator<char>());
+            if (rest) memcpy(b.get(), block.get() + pos, rest);
+            block = b;
+            capacity = size;
+        }
+        pos = 0;
+        end = rest;
+        ssize_t r = read(fd, block.get() + end, capacity - end);
+        if (r < 0) throw runtime_error("Can't read file");
+        if (r == 0) eof = true;
+        end += r;
+    }
+
+    int fd;
+    size_t recordSize;
+    shared_ptr<char> block;
+    size_t capacity = 0;
+    // Unread bytes are [pos, end)
+    size_t pos = 0, end = 0;
+    bool eof = false;
+};
+
+iterp ValueFile::iter() {
+    return iterp(new FileIterator(path, recordSize));
+}
+
+ValueWriter::ValueWriter(string path) : path(path) {
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw runtime_error("Can't open file " + path);
+    buffer.reserve(BLOCK_SIZE);
+}
+
+ValueWriter::~ValueWriter() {
+    try {
+        close();
+    } catch (runtime_error&) {}
+}
+
+valp ValueWriter::call(string f, vector<valp> args) {
+    if ((f == "write" || f == "writeLine") && args.size() == 1) {
+        if (fd < 0) throw runtime_error("Writing to closed file " + path);
+        if (auto s = dynamic_pointer_cast<ValueStr>(args[0])) buffer.append(s->data, s->size);
+        else buffer += args[0]->print();
+        if (f == "writeLine") buffer += '\n';
+        if (buffer.size() >= BLOCK_SIZE) flush();
+        return valp(new ValueNone());
+    }
+    if (f == "writeJson" && args.size() == 1) {
+        if (fd < 0) throw runtime_error("Writing to closed file " + path);
+        toJson(buffer, args[0]);
+        buffer += '\n';
+        if (buffer.size() >= BLOCK_SIZE) flush();
+        return valp(new ValueNone());
+    }
+    if (f == "flush" && args.size() == 0) {
+        flush();
+        return valp(new ValueNone());
+    }
+    if (f == "close" && args.size() == 0) {
+        close();
+        return valp(new ValueNone());
+    }
+    throw runtime_error("Unknown method");
+}
+
+void ValueWriter::flush() {
+    size_t done = 0;
+    while (done < buffer.size()) {
+        ssize_t w = write(fd, buffer.data() + done, buffer.size() - done);
+        if (w < 0) throw runtime_error("Can't write file " + path);
+        done += w;
+    }
+    buffer.clear();
+}
+
+void ValueWriter::close() {
+    if (fd < 0) return;
+    flush();
+    ::close(fd);
+    fd = -1;
+}
+
+void addFileFunctions(valp vars) {
+    vars->getRef("lines") = valp(new ValueNativeFunc([](vector<valp> a) {
+        if (a.size() != 1) throw runtime_error("Unmatched argument number");
+        return valp(new ValueFile(a[0]->getStr(), 0));
+    }));
+    vars->getRef("records") = valp(new ValueNativeFunc([](vector<valp> a) {
+        if (a.size() != 2) throw runtime_error("Unmatched argument number");
+        int size = a[1]->getInt();
+        if (size <= 0) throw runtime_error("Record size must be positive");
+        return valp(new ValueFile(a[0]->getStr(), size));
+    }));
+    vars->getRef("writer") = valp(new ValueNativeFunc([](vector<valp> a) {
+        if (a.size() != 1) throw runtime_error("Unmatched argument number");
+        return valp(new ValueWriter(a[0]->getStr()));
+    }));
+}
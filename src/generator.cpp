@@ -0,0 +1,162 @@
+#include <ascript/script.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Generators run the function body on a stack of their own. `yield` switches
+// back to the stack of the caller of next() and next() switches to the
+// generator stack again, so the interpreter needs no change to suspend in the
+// middle of nested statements.
+
+// Thrown at `yield` to unwind a generator destroyed before its end
+struct GeneratorExit {};
+
+bool hasYield(statp sp) {
+    // functions defined in the body are other functions, only statements are checked
+    if (auto s = dynamic_pointer_cast<YieldStat>(sp)) return true;
+    if (auto s = dynamic_pointer_cast<BlockStat>(sp)) {
+        for (auto ss : s->stats) if (hasYield(ss)) return true;
+    }
+    else if (auto s = dynamic_pointer_cast<IfStat>(sp)) return hasYield(s->then) || hasYield(s->els);
+    else if (auto s = dynamic_pointer_cast<WhileStat>(sp)) return hasYield(s->stat);
+    else if (auto s = dynamic_pointer_cast<ForStat>(sp)) return hasYield(s->stat);
+    return false;
+}
+
+struct Script::Generator {
+    Generator(Script* script, valp ctx, shared_ptr<ValueFunction> f, vector<valp> args)
+        : script(script), account(script->account), ctx(ctx), f(f), args(args) {}
+
+    // Counted in the script heap so that the account outlives the generator
+    static void* operator new(size_t size) { return heapAlloc(size); }
+    static void operator delete(void* p, size_t size) { heapFree(p, size); }
+
+    ~Generator() {
+        // unwind the suspended body so that its values are released, which
+        // needs the script; values of the body leak if it was destroyed first
+        if (stack && !done && account->scriptAlive) {
+            cancel = true;
+            try {
+                resume();
+            } catch (...) {
+                // destructors can't raise
+            }
+        }
+        if (stack) munmap(stack, stackSize);
+    }
+
+    // Runs body until next value, returns null at the end
+    valp resume() {
+        if (!account->scriptAlive) throw runtime_error("Generator used after its script");
+        // the saved context is stale while the body runs
+        if (running) throw runtime_error("Generator already running");
+        if (done) return nullptr;
+        if (!stack) start();
+        // the generator has its own call depth, return state and native stack
+        auto& s = *script;
+        StatsScope scope(s.account);
+        swap(s.depth, depth);
+        swap(s.ret, ret);
+        swap(s.tailCall, tailCall);
+        swap(s.module, module);
+        swap(s.stackLimit, stackLimit);
+        Generator* caller = s.generator;
+        s.generator = this;
+        running = true;
+        swapcontext(&callerContext, &context);
+        running = false;
+        s.generator = caller;
+        swap(s.depth, depth);
+        swap(s.ret, ret);
+        swap(s.tailCall, tailCall);
+        swap(s.module, module);
+        swap(s.stackLimit, stackLimit);
+        if (error) {
+            auto e = error;
+            error = nullptr;
+            rethrow_exception(e);
+        }
+        valp v = value;
+        value = nullptr;
+        return v;
+    }
+
+    // Switches back to the caller of resume
+    void suspend() {
+        swapcontext(&context, &callerContext);
+        if (cancel) throw GeneratorExit();
+    }
+
+    void start() {
+        // calls switch to a new stack past the same budget as the main stack,
+        // with room for the statements between two checks
+        size_t page = sysconf(_SC_PAGESIZE);
+        stackSize = (script->maxStackSize + (1 << 20) + page - 1) / page * page;
+        stack = mmap(nullptr, stackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (stack == MAP_FAILED) {
+            stack = nullptr;
+            throw runtime_error("Can't allocate generator stack");
+        }
+        // guard page
+        mprotect(stack, page, PROT_NONE);
+        getcontext(&context);
+        context.uc_stack.ss_sp = stack;
+        context.uc_stack.ss_size = stackSize;
+        context.uc_link = &callerContext;
+        // makecontext only passes ints
+        uintptr_t p = (uintptr_t)this;
+        makecontext(&context, (void (*)())entry, 2, (unsigned)(p >> 32), (unsigned)p);
+    }
+
+    static void entry(unsigned hi, unsigned lo) {
+        auto g = (Generator*)(((uintptr_t)hi << 32) | lo);
+        try {
+            g->script->invoke(g->ctx, g->f, g->args);
+        } catch (GeneratorExit) {
+        } catch (...) {
+            g->error = current_exception();
+        }
+        g->done = true;
+        g->ctx = nullptr;
+        g->args.clear();
+        // returns to callerContext through uc_link
+    }
+
+    Script* script;
+    StatsAccount* account;
+    valp ctx;
+    shared_ptr<ValueFunction> f;
+    vector<valp> args;
+    ucontext_t context, callerContext;
+    void* stack = nullptr;
+    size_t stackSize = 0;
+    // Interpreter state of the generator while it is suspended
+    size_t depth = 0;
+    valp ret;
+    unique_ptr<TailCall> tailCall;
+    Module* module = nullptr;
+    uintptr_t stackLimit = 0;
+    // Last yielded value
+    valp value;
+    exception_ptr error;
+    bool done = false;
+    bool cancel = false;
+    bool running = false;
+};
+
+valp Script::makeGenerator(valp ctx, shared_ptr<ValueFunction> f, vector<valp> args) {
+    StatsScope scope(account);
+    shared_ptr<Generator> g(new Generator(this, ctx, f, args));
+    return valp(new ValueGenerator([g]() {
+        return g->resume();
+    }));
+}
+
+void Script::yield(valp v) {
+    if (!generator) throw runtime_error("Can't yield outside of a function");
+    Generator* g = generator;
+    g->value = v;
+    g->suspend();
+}
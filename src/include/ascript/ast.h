@@ -10,13 +10,18 @@ struct SourceInfo {
     size_t end_index;
 };
 
+// Nodes allocated with new count in heapBytes of the script being loaded
 struct Stat {
     virtual ~Stat() {}
+    static void* operator new(size_t size) { return heapAlloc(size); }
+    static void operator delete(void* p, size_t size) { heapFree(p, size); }
     SourceInfo srcinfo;
 };
 
 struct Exp {
     virtual ~Exp() {}
+    static void* operator new(size_t size) { return heapAlloc(size); }
+    static void operator delete(void* p, size_t size) { heapFree(p, size); }
     SourceInfo srcinfo;
 };
 
@@ -78,6 +83,20 @@ struct ReturnStat : public Stat {
     expp e;
 };
 
+// yield e
+// makes the enclosing function a generator
+struct YieldStat : public Stat {
+    YieldStat(expp e) : e(e) {}
+    expp e;
+};
+
+// import "path" as name
+struct ImportStat : public Stat {
+    ImportStat(std::string path, std::string name) : path(path), name(name) {}
+    std::string path;
+    std::string name;
+};
+
 // Int literal
 struct IntExp : public Exp {
     IntExp(int v) : value(v) {}
@@ -86,7 +105,7 @@ struct IntExp : public Exp {
 
 // Float literal
 struct FloatExp : public Exp {
-    FloatExp(int v) : value(v) {}
+    FloatExp(float v) : value(v) {}
     float value;
 };
 
@@ -140,9 +159,13 @@ struct FuncCallExp : public Exp {
 
 // function(args...) body
 struct FuncDefExp : public Exp {
-    FuncDefExp(std::vector<std::string> args, statp body) : args(args), body(body) {}
+    FuncDefExp(std::vector<std::string> args, statp body, std::string name = "") : args(args), body(body), name(name) {}
     std::vector<std::string> args;
     statp body;
+    // Variable or member the definition is assigned to, empty if none
+    std::string name;
+    // Code compiled by ascriptc, null if none
+    NativeCode native = nullptr;
 };
 
 // String literal
@@ -168,4 +191,23 @@ struct MemberExp : public Exp {
 struct TernaryExp : public Exp {
     TernaryExp(expp cond, expp then, expp els) : cond(cond), then(then), els(els) {}
     expp cond, then, els;
-};
\ No newline at end of file
+};
+
+// l and r
+// r is only evaluated if l is true, the value is l if it is false, else r
+struct AndExp : public Exp {
+    AndExp(expp l, expp r) : l(l), r(r) {}
+    expp l, r;
+};
+
+// l or r
+// r is only evaluated if l is false, the value is l if it is true, else r
+struct OrExp : public Exp {
+    OrExp(expp l, expp r) : l(l), r(r) {}
+    expp l, r;
+};
+
+class Source;
+// Parses script source into its AST
+// Raises a LoadError with every syntax error of the source
+statp parse(std::shared_ptr<const Source> source);
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Value copied out of the heap of a script, see Channel
+struct Message {
+    enum Kind : uint8_t { None, Int, Float, Str, List, Map, Vec, Mat, SparseList, Range };
+    Kind kind = None;
+    int i = 0;
+    float f = 0;
+    // Beginning, end and step of a range
+    int range[3] = {};
+    // Bytes of a string viewing shared bytes, immutable so the sender and
+    // receiver strings share them
+    std::shared_ptr<const void> owner;
+    std::string_view view;
+    // Bytes of other strings, moved into the receiver string
+    std::string text;
+    // Elements of a list, values of a map
+    std::vector<Message> items;
+    // Indices of the elements of a sparse list, and its length
+    std::vector<size_t> indices;
+    size_t length = 0;
+    // Names of a map
+    std::vector<std::string> keys;
+    // Components of a vector or matrix
+    std::vector<float> floats;
+};
+
+// Bounded queue of values between scripts running on different threads
+// Values are copied out of the sender heap and rebuilt in the receiver heap,
+// scripts never share values. Any number of threads may send, one thread
+// receives at a time: receiving while another thread receives raises.
+// Sending and receiving don't lock, receivers sleep only after spinning on an
+// empty channel.
+class Channel {
+public:
+    /* capacity = max waiting values, rounded up to a power of 2 */
+    Channel(size_t capacity = 1024);
+    // Queues a copy of v, waits while the channel is full
+    // Linked variables are sent by value; functions, modules and cyclic
+    // values can't be sent
+    void send(const valp& v);
+    // Same as send, returns false instead of waiting when full
+    bool trySend(const valp& v);
+    // Waits for the next value, allocated by the script running on this thread
+    valp receive();
+    // Next value, null if none is waiting
+    valp tryReceive();
+    size_t capacity() const { return mask + 1; }
+private:
+    bool push(Message& m);
+    bool pop(Message& m);
+    // seq = position the slot is written at, position+1 once written
+    struct Slot {
+        std::atomic<size_t> seq;
+        Message message;
+    };
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    // Next position to write, shared by senders
+    alignas(64) std::atomic<size_t> head{0};
+    // Next position to read, owned by the receiver
+    alignas(64) std::atomic<size_t> tail{0};
+    // Set while a thread receives
+    std::atomic<bool> receiving{false};
+    friend struct ReceiverGuard;
+    // Receivers waiting for a value
+    alignas(64) std::atomic<int> sleepers{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+};
+
+// Channel connected to a script, see Script::connect
+struct ValueChannel : public Value {
+    ValueChannel(std::shared_ptr<Channel> channel) : channel(channel) {}
+    /* send(v), trySend(v) = whether v was queued
+       receive(), tryReceive() = next value, None if none is waiting */
+    virtual valp call(std::string f, std::vector<valp> args);
+    virtual std::string print();
+    std::shared_ptr<Channel> channel;
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "script.h"
+#include <climits>
+
+// Script compiled ahead of time by ascriptc
+struct CompiledScript {
+    // Path the script was compiled from, Script(path) loads the compiled version
+    std::string filename;
+    std::string source;
+    // Builds the script AST
+    statp (*build)();
+};
+
+// Makes script available to Script(path), returns true so it can initialize a static
+bool registerCompiledScript(const CompiledScript* script);
+
+// Creates AST node T from constructor arguments
+template <typename T, typename ...Args>
+std::shared_ptr<T> node(SourceInfo srcinfo, Args&&... args) {
+    auto n = std::make_shared<T>(std::forward<Args>(args)...);
+    n->srcinfo = srcinfo;
+    return n;
+}
+
+// Script state of native code compiled by ascriptc
+// Native code only computes on ints and floats, so it can bail out anywhere
+// and let the interpreter run the call again from its start.
+struct NativeCall {
+    Script* script;
+    // Module of the running function, null for the main script
+    Module* module;
+    // Script call depth and its limit, native code bails out past it
+    size_t depth;
+    size_t maxDepth;
+    // Native stack address calls don't go below
+    uintptr_t stackLimit;
+    // Script function calls made from native code
+    size_t calls = 0;
+};
+
+// Call from native code to the script function name, which must still be the
+// function compiled as code
+struct NativeCallee {
+    enum Mode { Bail, Native, Interpreted };
+    NativeCallee(NativeCall& c) : c(c), module(c.module) {}
+    ~NativeCallee() {
+        if (!entered) return;
+        c.module = module;
+        c.depth--;
+    }
+    // Calls too deep for the native stack or the depth limit are interpreted,
+    // the interpreter switches stacks or raises
+    Mode enter(const std::string& name, NativeCode code);
+    // Runs the call entered as Interpreted
+    valp interpret(std::vector<valp> args);
+    // Whether name is still the function of code, for tail calls
+    static bool same(NativeCall& c, const std::string& name, NativeCode code);
+    NativeCall& c;
+    Module* module;
+    const std::string* name = nullptr;
+    bool entered = false;
+};
+
+inline bool nativeArg(const valp& v, int& i) {
+    auto x = dynamic_cast<ValueInt*>(v.get());
+    if (!x) return false;
+    i = x->value;
+    return true;
+}
+
+inline bool nativeArg(const valp& v, float& f) {
+    auto x = dynamic_cast<ValueFloat*>(v.get());
+    if (!x) return false;
+    f = x->value;
+    return true;
+}
+
+inline valp nativeValue(int i) {
+    return valp(new ValueInt(i));
+}
+
+inline valp nativeValue(float f) {
+    return valp(new ValueFloat(f));
+}
+
+// Calls f, the code of the script function name, with args into r
+template <typename F, typename R, typename ...A>
+bool nativeCall(NativeCall& c, const std::string& name, NativeCode code, F f, R& r, A... args) {
+    NativeCallee callee(c);
+    switch (callee.enter(name, code)) {
+    case NativeCallee::Native: return f(c, args..., r);
+    case NativeCallee::Interpreted: return nativeArg(callee.interpret({nativeValue(args)...}), r);
+    default: return false;
+    }
+}
+
+// Definition e whose calls run code first
+inline std::shared_ptr<FuncDefExp> nativeNode(std::shared_ptr<FuncDefExp> e, NativeCode code) {
+    e->native = code;
+    return e;
+}
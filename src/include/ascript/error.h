@@ -1,11 +1,51 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
 
+// Script text, with the offsets where its lines start
+class Source {
+public:
+    /* filename = path the text was loaded from
+       text = file contents */
+    Source(std::string filename, std::string text);
+    // Line n, counted from 1, without its end of line; empty if out of range
+    std::string_view line(size_t n) const;
+    const std::string filename;
+    const std::string text;
+private:
+    std::vector<size_t> lineStarts;
+};
+
+// Error raised while running a script
+// Only the message and location are kept, the report with the source line is
+// formatted on the first call to what()
 class InterpreterError : public std::exception {
 public:
-    InterpreterError(std::string filename, std::string source, SourceInfo srcinfo, const std::string &str);
+    InterpreterError(std::shared_ptr<const Source> source, SourceInfo srcinfo, std::string message);
+    virtual const char* what() const noexcept;
+    // Message without location
+    const std::string& message() const { return msg; }
+    const SourceInfo& where() const { return srcinfo; }
+    const std::string& filename() const { return source->filename; }
+private:
+    std::shared_ptr<const Source> source;
+    SourceInfo srcinfo;
+    std::string msg;
+    // Formatted by what()
+    mutable std::string str;
+};
+
+// Syntax errors of one or more script files, reported together
+class LoadError : public std::exception {
+public:
+    LoadError(std::vector<InterpreterError> errors);
+    // Reports of all errors, one after the other
     virtual const char* what() const noexcept;
+    const std::vector<InterpreterError>& errors() const { return list; }
 private:
-    std::string str;
-};
\ No newline at end of file
+    std::vector<InterpreterError> list;
+    mutable std::string str;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Lines or fixed size records of a file, read in large blocks while iterated
+// Elements are string views into the blocks
+struct ValueFile : public Value {
+    /* path = file to read
+       recordSize = bytes per element, 0 to iterate lines */
+    ValueFile(std::string path, size_t recordSize) : path(path), recordSize(recordSize) {}
+    virtual iterp iter();
+    virtual std::string print();
+    std::string path;
+    size_t recordSize;
+};
+
+// File written through a buffer, flushed when full, on flush() and on close()
+struct ValueWriter : public Value {
+    ValueWriter(std::string path);
+    ~ValueWriter();
+    // write(v), writeLine(v), writeJson(v) = v as JSON on a line, flush(), close()
+    virtual valp call(std::string f, std::vector<valp> args);
+    virtual std::string print();
+    void flush();
+    void close();
+    std::string path;
+    int fd;
+    std::string buffer;
+};
+
+// Defines lines(path), records(path, size) and writer(path) in vars
+void addFileFunctions(valp vars);
@@ -1,31 +1,175 @@
 #pragma once
 
 #include <string>
+#include <cstdint>
+#include <unordered_map>
+#include <type_traits>
+
+template <typename T>
+class ScriptFunction;
+
+// Script file imported by another script
+struct Module {
+    std::string filename;
+    std::shared_ptr<const Source> source;
+    statp code;
+    // Module global variables
+    std::shared_ptr<ValueModule> variables;
+};
 
 class Script {
 public:
+    enum class Engine {
+        // Walks the AST
+        Tree,
+        // Converts the AST once into native closures and runs them
+        Closure
+    };
     // Loads script from path
+    // Raises a LoadError with the syntax errors of the file
     Script(std::string path);
+    ~Script();
+    // Loads scripts from paths, parsing files on threads threads at once
+    // (hardware threads if 0). Scripts are in the order of paths.
+    // Raises a LoadError with the syntax errors of every file once all are parsed.
+    static std::vector<std::unique_ptr<Script>> loadAll(const std::vector<std::string>& paths, size_t threads = 0);
     // Launches script
     void run();
     // Returns whether script has finished
     bool isOver();
+    // Sets the maximum number of nested script function calls
+    void setMaxCallDepth(size_t depth);
+    // Sets the native stack size in bytes used by nested calls before they
+    // continue on stacks allocated by the script
+    void setMaxStackSize(size_t size);
+    // Enables compilation of hot script functions to machine code
+    void setJit(bool enabled);
+    // Sets the number of calls after which a function is compiled
+    void setJitThreshold(size_t calls);
+    // Selects how statements are executed
+    void setEngine(Engine engine);
+    // Records calls and errors in the trace of the running thread, see trace.h
+    void setTracing(bool enabled);
+    // Saves script variables and those of the script modules which ran to a
+    // binary image at path
+    // Native functions, linked variables and channels are left out
+    void snapshot(std::string path);
+    // Loads script variables saved by snapshot from the same script and
+    // module sources, replaces running the script and module initialization
+    void restore(std::string path);
+
+    // Applies the changes made to the file at path since it was loaded, path
+    // being the script or one of its loaded modules. Variables are kept and
+    // the code outside functions isn't run again. Existing functions run
+    // their new definition, functions compiled to machine code are compiled
+    // again only if their text changed. Functions added at the top level are
+    // defined. Must not be called while the script runs.
+    // Raises a LoadError with the syntax errors of the file, leaving the script as it was.
+    void reload(std::string path);
+
+    // Returns counters of the work done by the script since it was loaded
+    // heapBytes and peakHeapBytes are the current and peak memory of the script
+    ScriptStats stats() const;
+    // Limits the memory of the script, see ScriptStats::heapBytes, 0 for no limit
+    // onSoftLimit(heapBytes) is called the first time the heap grows past soft
+    // bytes, setting the limits again rearms it. It runs on the thread of the
+    // script, in the middle of an allocation, and must not call the script.
+    // Allocations that would take the heap past hard bytes fail with an error
+    // raised in the script instead.
+    void setMemoryLimits(size_t soft, size_t hard, std::function<void(size_t)> onSoftLimit = nullptr);
+
+    // Calls script function name with args
+    valp call(std::string name, std::vector<valp> args);
+    // Returns handle calling script function name with native types,
+    // T is the function type, e.g. int(int, float)
+    template <typename T>
+    ScriptFunction<T> getFunction(std::string name);
+    // Calls script function name once per item, item i takes the i-th element
+    // of every column as arguments and its result is stored in out[i]
+    template <typename Ret, typename ...Args>
+    void callBatch(std::string name, size_t count, Ret* out, const Args*... columns) {
+        Batch batch = prepareBatch(name, sizeof...(Args));
+        for (size_t i=0;i<count;i++) {
+            out[i] = batchItem<Ret>(batch, columns[i]...);
+        }
+    }
+    // Same as callBatch with arguments taken from fields of items
+    template <typename Ret, typename T, typename ...Fields>
+    void callBatch(std::string name, const T* items, size_t count, Ret* out, Fields T::*... fields) {
+        Batch batch = prepareBatch(name, sizeof...(Fields));
+        for (size_t i=0;i<count;i++) {
+            out[i] = batchItem<Ret>(batch, items[i].*fields...);
+        }
+    }
 
     // Links reference to script variable
     template <typename T>
     void link(std::string name, T& ref) {
-        variables->getRef(name) = valp(new ValueExtern<T>(ref));
+        if constexpr (VecLayout<T>::size > 0) {
+            variables->getRef(name) = valp(new ValueVecExtern((float*)&ref, VecLayout<T>::size));
+        } else {
+            variables->getRef(name) = valp(new ValueExtern<T>(ref));
+        }
+    }
+    // Makes channel a script variable, several scripts may share a channel
+    void connect(std::string name, std::shared_ptr<Channel> channel) {
+        variables->getRef(name) = valp(new ValueChannel(channel));
     }
     // Links native function to script variable
     template <typename T>
     void linkFunction(std::string name, std::function<T> f) {
-        // Create wrapper function that takes list of values and returns value
-        variables->getRef(name) = valp(new ValueNativeFunc([&](auto a) {
-            return call(f, a);
-        }));
+        variables->getRef(name) = wrapFunction(f);
     }
 
 private:
+    template <typename T>
+    friend class ScriptFunction;
+    friend class Callback;
+
+    // Function called by callBatch, with the values reused from one call to the next
+    struct Batch {
+        valp ctx;
+        std::shared_ptr<ValueFunction> f;
+        // Function variables, reset to none after each call
+        valp env;
+        valp none;
+        std::vector<valp> args;
+        // Set during a call, nested calls then get their own variables
+        bool running = false;
+    };
+    // Returns script function defined in script variables
+    std::shared_ptr<ValueFunction> findFunction(std::string name);
+    Batch prepareBatch(std::string name, size_t argCount);
+    Batch prepareBatch(std::shared_ptr<ValueFunction> f, size_t argCount);
+    // Calls batch function with args stored in batch.args
+    valp callBatch(Batch& batch);
+    template <typename Ret, typename ...Args>
+    Ret batchItem(Batch& batch, Args... args) {
+        if constexpr ((std::is_same_v<Args, int> && ...)) {
+            // machine code takes ints without boxing
+            int iargs[] = {args..., 0};
+            int result;
+            if (jitEnabled && batch.f->jit && !tracing && batch.f->jit->run(iargs, result)) {
+                account->stats.scriptCalls++;
+                if constexpr (std::is_same_v<Ret, int>) return result;
+                else return convertResult<Ret>(valp(new ValueInt(result)));
+            }
+        }
+        size_t i = 0;
+        ((setArg(batch.args[i++], args)), ...);
+        return convertResult<Ret>(callBatch(batch));
+    }
+    template <typename Ret>
+    static Ret convertResult(valp v) {
+        if constexpr (std::is_void_v<Ret>) return;
+        else if constexpr (std::is_same_v<Ret, valp>) return v;
+        else return convert<Ret>(v);
+    }
+
+    // Script running code parsed from source, counted in account
+    Script(std::shared_ptr<const Source> source, statp code, StatsAccount* account);
+    // Defines native functions available to every script
+    void addBuiltins();
     void load(std::string path);
     // Executes statement s with context vars
     void exec(valp vars, statp s);
@@ -36,13 +180,150 @@ private:
     valp& evalRef(valp vars, expp lp);
 
     valp evalFunc(valp ctx, std::string f, std::vector<valp> args);
+    valp evalCall(valp vars, std::shared_ptr<FuncCallExp> e, bool tail);
+    valp callWithArgs(valp vars, const FuncCallExp& e, valp vctx, std::vector<valp>& args, bool tail);
+    // Runs s with the selected engine
+    void run(valp vars, statp s);
+    // Error at srcinfo in the file being executed
+    InterpreterError error(SourceInfo srcinfo, std::string str);
+    // Returns variables of module at path, relative to the file being executed
+    valp import(std::string path);
+    // Returns variables of module at resolved path
+    valp getModule(std::string path);
+    // Defines function in the module being executed
+    valp makeFunction(std::vector<std::string> args, statp body, std::string name, NativeCode native = nullptr);
+    // Calls native function name between enter and exit trace records
+    template <typename F>
+    valp traceNative(const std::string& name, F call) {
+        traceEvent(TraceRecord::Enter, TraceRecord::Native, name);
+        try {
+            valp v = call();
+            traceEvent(TraceRecord::Exit, TraceRecord::Native, name);
+            return v;
+        } catch (...) {
+            traceEvent(TraceRecord::Exit, TraceRecord::Native, name);
+            throw;
+        }
+    }
+
+    // Closure engine
+    using StatFn = std::function<void(const valp&)>;
+    using ExpFn = std::function<valp(const valp&)>;
+    using RefFn = std::function<valp&(const valp&)>;
+    StatFn compile(statp s);
+    ExpFn compile(expp e);
+    RefFn compileRef(expp e);
+    // Calls script function f with `this` bound to ctx
+    valp callFunction(valp ctx, std::shared_ptr<ValueFunction> f, std::vector<valp> args);
+    // Runs f as machine code if compiled, counts calls to compile hot functions
+    bool runJit(ValueFunction& f, const std::vector<valp>& args, valp& result);
+    // Runs the code compiled by ascriptc for f if it can run the call
+    bool runNative(ValueFunction& f, const std::vector<valp>& args, valp& result);
+    // Function name called from native code running in module, null if it isn't a script function
+    ValueFunction* nativeCallee(Module* module, const std::string& name);
+    friend struct NativeCallee;
+    // Runs body of f in a new frame, with variables in env if not null
+    valp invoke(valp ctx, std::shared_ptr<ValueFunction> f, std::vector<valp> args, valp env = nullptr);
+    // Runs invoke on a stack of its own once the current one is used up
+    valp invokeOnNewStack(valp ctx, std::shared_ptr<ValueFunction> f, std::vector<valp> args, valp env);
+    // Returns generator running f, called in place of f when its body contains `yield`
+    valp makeGenerator(valp ctx, std::shared_ptr<ValueFunction> f, std::vector<valp> args);
+    // Suspends the running generator with value v
+    void yield(valp v);
 
+    // Native stack mapped by the script for nested calls
+    struct Stack {
+        void* base;
+        size_t size;
+    };
+    // Call to perform after the current frame returns (`return f(...)`)
+    struct TailCall {
+        valp ctx;
+        std::shared_ptr<ValueFunction> f;
+        std::vector<valp> args;
+    };
+
+    struct Generator;
+
+    // Stats, owned by the script until it is destroyed
+    StatsAccount* account = new StatsAccount();
     // Current return value; null means not returning
     valp ret = nullptr;
+    // Number of script function calls being run
+    size_t depth = 0;
+    size_t maxCallDepth = 10000;
+    size_t maxStackSize = 1 << 20;
+    // Lowest native stack address calls run at before switching to a new stack
+    uintptr_t stackLimit = 0;
+    // Stacks left by calls that returned, reused by the next ones
+    std::vector<Stack> freeStacks;
+    // Pending tail call; null if none
+    std::unique_ptr<TailCall> tailCall;
+    // Generator being run, null if none
+    Generator* generator = nullptr;
+    bool jitEnabled = false;
+    size_t jitThreshold = 100;
+    Engine engine = Engine::Tree;
+    bool tracing = false;
+    // Closure of a statement, which it keeps so that the address of the
+    // statement isn't reused while it is cached
+    struct Compiled {
+        statp stat;
+        StatFn run;
+    };
+    // Closures of compiled statements (function bodies and script code)
+    std::unordered_map<Stat*, Compiled> compiled;
+    // Functions created from each body, rebound to their new body by reload
+    std::unordered_map<Stat*, std::vector<std::weak_ptr<ValueFunction>>> functions;
     // Script variables
     valp variables = valp(new ValueMap({}));
+    // Imported modules by path
+    std::map<std::string, std::unique_ptr<Module>> modules;
+    // Module being executed, null for the main script
+    Module* module = nullptr;
     // AST to execute
     statp code;
-    std::string source;
+    std::shared_ptr<const Source> source;
     std::string filename;
-};
\ No newline at end of file
+};
+
+// Script function called from native code
+// Keeps calling the function found by getFunction if the script variable is reassigned
+template <typename Ret, typename ...Args>
+class ScriptFunction<Ret(Args...)> {
+public:
+    static const size_t argCount = sizeof...(Args);
+    Ret operator()(Args... args) {
+        return script->batchItem<Ret>(*batch, args...);
+    }
+private:
+    friend class Script;
+    ScriptFunction(Script* script, Script::Batch batch) : script(script), batch(new Script::Batch(batch)) {}
+    Script* script;
+    // Shared by copies so that they don't reuse the same variables at once
+    std::shared_ptr<Script::Batch> batch;
+};
+
+template <typename T>
+ScriptFunction<T> Script::getFunction(std::string name) {
+    return ScriptFunction<T>(this, prepareBatch(name, ScriptFunction<T>::argCount));
+}
+
+// Function value called repeatedly from native code, such as list methods
+// Script functions reuse their variables between calls like ScriptFunction
+class Callback {
+public:
+    /* f = script or native function
+       argCount = number of arguments passed by the caller */
+    Callback(valp f, size_t argCount);
+    valp operator()(valp a);
+    valp operator()(valp a, valp b);
+    // a has argCount elements
+    valp operator()(const std::vector<valp>& a);
+private:
+    valp call();
+    std::shared_ptr<ValueFunction> f;
+    std::shared_ptr<ValueNativeFunc> native;
+    std::unique_ptr<Script::Batch> batch;
+    std::vector<valp> args;
+};
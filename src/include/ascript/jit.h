@@ -0,0 +1,22 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+// Machine code compiled from a script function (x86-64 Linux only)
+// Supported functions only use int arguments, int literals, arithmetic,
+// comparison and boolean operators, ternaries, if and return.
+class JitFunction {
+public:
+    ~JitFunction();
+    // Compiles f, returns null if f can't be compiled
+    static std::shared_ptr<JitFunction> compile(ValueFunction& f);
+    // Runs code with int arguments, returns false if the interpreter must run the call instead
+    bool run(const int* args, int& result);
+private:
+    JitFunction() {}
+    // Code signature: int code(const int* args, int* result), returns 0 to bail out
+    int (*code)(const int*, int*) = nullptr;
+    size_t size = 0;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <memory>
+
+// Value of the JSON document text
+// Objects are maps, arrays lists, true and false 1 and 0, null None
+// Numbers are ints unless they have a fraction or exponent or don't fit
+// Strings longer than short strings view text when owner keeps it valid
+valp fromJson(std::string_view text, std::shared_ptr<const void> owner = nullptr);
+// Appends v as JSON to out
+// Lists, ranges, vectors and matrices are arrays, maps objects
+// Functions and cyclic values can't be written
+void toJson(std::string& out, const valp& v);
+
+// Defines in vars
+// parseJson(text) = value of the JSON document text
+// parseJson(text, f) = calls f on each element of the top array, or once on the
+//   whole document if it isn't an array, and returns the number of calls.
+//   Elements are freed after their call, the array is never built.
+// toJson(v) = v as a JSON string
+void addJsonFunctions(valp vars);
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Function whose results are cached by arguments, made by memoize(f)
+// Arguments are keyed by content: ints, floats, strings, None and lists of
+// these. Calls with other arguments always run the function.
+// The least recently used result is dropped when capacity results are cached.
+struct ValueMemo : public ValueNativeFunc {
+    /* f = script or native function, supposed to give the same result for the same arguments
+       capacity = max cached results */
+    ValueMemo(valp f, size_t capacity);
+    /* hits(), misses() = calls answered from the cache and the others
+       size() = number of cached results
+       clear() = drops cached results */
+    virtual valp call(std::string f, std::vector<valp> args);
+    virtual std::string print();
+    valp function;
+    size_t capacity;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+private:
+    valp lookup(const std::vector<valp>& args);
+    struct Entry {
+        std::string key;
+        valp result;
+    };
+    // Most recently used first
+    std::list<Entry> entries;
+    // Entries by key, viewing the key of the entry
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+};
+
+// Defines memoize(f) and memoize(f, capacity) in vars
+void addMemoFunctions(valp vars);
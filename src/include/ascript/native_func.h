@@ -12,6 +12,16 @@ valp convertRet(T a);
 template <typename T>
 T convert(valp a);
 
+// Stores a converted into script value in v, reuses the value in v if nothing else refers to it
+template <typename T>
+void setArg(valp& v, T a) {
+    v = convertRet(a);
+}
+template <>
+void setArg(valp& v, int a);
+template <>
+void setArg(valp& v, float a);
+
 // Call native function with converted arguments
 template <typename Ret, typename ...Args, size_t ...I>
 Ret call0(std::function<Ret(Args...)> f, std::vector<valp>& a, std::index_sequence<I...>) {
@@ -26,3 +36,22 @@ valp call(std::function<Ret(Args...)> f, std::vector<valp>& a) {
     return convertRet(call0(f, a, std::make_index_sequence<sizeof...(Args)>{}));
 }
 
+// Wraps native function into a script value
+template <typename T>
+valp wrapFunction(std::function<T> f) {
+    // Create wrapper function that takes list of values and returns value
+    return valp(new ValueNativeFunc([f](std::vector<valp> a) {
+        return call(f, a);
+    }));
+}
+
+/* Native modules are shared objects imported with `import "lib.so" as lib`.
+   They define an entry point that fills the module variables:
+
+   extern "C" void ascript_register(ValueMap& module) {
+       module.getRef("square") = wrapFunction<int(int)>([](int x) { return x*x; });
+   }
+
+   The host program must export the ascript symbols (link it with -rdynamic). */
+using ModuleEntry = void (*)(ValueMap&);
+#define ASCRIPT_MODULE_ENTRY "ascript_register"
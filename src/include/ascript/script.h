@@ -1,7 +1,15 @@
 #pragma once
 
+#include "stats.h"
+#include "trace.h"
 #include "value.h"
+#include "vector.h"
+#include "channel.h"
 #include "ast.h"
 #include "error.h"
 #include "native_func.h"
+#include "jit.h"
+#include "file.h"
+#include "json.h"
+#include "memo.h"
 #include "interpreter.h"
\ No newline at end of file
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+// Counters of the work done by a script, see Script::stats
+struct ScriptStats {
+    // Kinds of values counted separately
+    enum ValueKind { Int, Float, Str, List, Map, Function, Vec, Other, ValueKinds };
+    // Statements executed, blocks included
+    uint64_t statements = 0;
+    // Calls to script functions, including those run as machine code
+    uint64_t scriptCalls = 0;
+    // Calls to native functions and to methods of values
+    uint64_t nativeCalls = 0;
+    // Values created, by kind
+    uint64_t values[ValueKinds] = {};
+    // Bytes allocated by the script and not freed yet: values, the bytes of
+    // strings, elements of lists and maps, and AST nodes of the script and
+    // its modules
+    int64_t heapBytes = 0;
+    // Maximum of heapBytes
+    int64_t peakHeapBytes = 0;
+    // Names looked up in maps, variables included
+    uint64_t mapLookups = 0;
+    // Errors raised while running the script
+    uint64_t exceptions = 0;
+    // Calls to memoized functions answered from their cache, and the others
+    uint64_t memoHits = 0;
+    uint64_t memoMisses = 0;
+    // Counters in Prometheus text format, one `ascript_<name> <value>` line each
+    std::string dump() const;
+};
+
+// Stats of a script, also referenced by the values it created so that they can
+// be freed after the script
+// Only the thread running the script charges bytes, any thread credits them.
+struct StatsAccount {
+    // heapBytes is kept apart, see heapBytes()
+    ScriptStats stats;
+    // Cleared when the script is destroyed, the account is then freed with its last value
+    std::atomic<bool> scriptAlive{true};
+    // Limits of heapBytes, see Script::setMemoryLimits
+    int64_t softLimit = INT64_MAX;
+    int64_t hardLimit = INT64_MAX;
+    std::function<void(size_t)> onSoftLimit;
+    // Set once heapBytes went past softLimit
+    bool softLimitReached = false;
+    // Adds bytes to heapBytes, raises instead if they would go past hardLimit
+    void charge(size_t bytes) {
+        int64_t heap = heapCharged + bytes - heapCredited.load(std::memory_order_relaxed);
+        if (heap > watermark) chargePeak(heap);
+        heapCharged += bytes;
+    }
+    // Removes bytes from heapBytes, returns true when they were the last ones
+    // counted after release, the caller then frees the account
+    bool credit(size_t bytes) {
+        return heapCredited.fetch_add(bytes, std::memory_order_acq_rel) == -(int64_t)bytes;
+    }
+    // Called by the script when it is destroyed, returns true when no bytes are
+    // counted anymore, the caller then frees the account
+    bool release() {
+        scriptAlive = false;
+        return heapCredited.fetch_sub(heapCharged, std::memory_order_acq_rel) == heapCharged;
+    }
+    // Bytes charged and not credited yet, read by the thread running the script
+    int64_t heapBytes() const {
+        return heapCharged - heapCredited.load(std::memory_order_relaxed);
+    }
+    // Sets watermark after the limits changed
+    void updateWatermark();
+    // Account of the script running on this thread, null if none
+    static inline thread_local StatsAccount* current = nullptr;
+private:
+    // heapBytes up to which charge doesn't need to update the peak or check limits
+    int64_t watermark = 0;
+    // Bytes charged
+    int64_t heapCharged = 0;
+    // Bytes credited, minus the bytes charged once released so that the
+    // credit bringing it back to 0 is the last one
+    std::atomic<int64_t> heapCredited{0};
+    // Charges past the watermark
+    void chargePeak(int64_t heap);
+};
+
+// Raises for allocations that failed
+[[noreturn]] void heapExhausted(StatsAccount* account, size_t size);
+// Raises like charge would when size bytes more go past the hard limit of the
+// script running on this thread, without counting them; called before
+// allocating memory counted once allocated, like the bytes of strings
+void checkHeap(size_t size);
+
+// Size of the header holding the account before memory of heapAlloc, keeps
+// the memory aligned for any type
+const size_t HEAP_HEADER = alignof(std::max_align_t);
+
+// Memory counted in the heap of the script running on this thread like
+// values, freed on any thread. Aligned like ::operator new.
+// Memory is allocated after the account it counts in.
+inline void* heapAlloc(size_t size) {
+    auto a = StatsAccount::current;
+    // raises before allocating when over the hard limit
+    if (a) a->charge(size);
+    auto header = (char*)::operator new(HEAP_HEADER + size, std::nothrow);
+    if (!header) heapExhausted(a, size);
+    *(StatsAccount**)header = a;
+    return header + HEAP_HEADER;
+}
+
+// Credits bytes counted in account, frees the account with the last bytes
+// counted after its script was destroyed
+inline void heapCredit(StatsAccount* a, size_t size) {
+    if (size && a->credit(size)) delete a;
+}
+
+inline void heapFree(void* p, size_t size) {
+    auto header = (char*)p - HEAP_HEADER;
+    if (auto a = *(StatsAccount**)header) heapCredit(a, size);
+    ::operator delete(header);
+}
+
+// Allocator of the elements of lists and maps, see heapAlloc
+template <typename T>
+struct HeapAllocator {
+    using value_type = T;
+    HeapAllocator() = default;
+    template <typename U>
+    HeapAllocator(const HeapAllocator<U>&) {}
+    T* allocate(size_t n) {
+        static_assert(alignof(T) <= HEAP_HEADER, "Over-aligned type");
+        return (T*)heapAlloc(n * sizeof(T));
+    }
+    void deallocate(T* p, size_t n) { heapFree(p, n * sizeof(T)); }
+    template <typename U>
+    bool operator==(const HeapAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const HeapAllocator<U>&) const { return false; }
+};
+
+// Counts work done on this thread in account while alive
+class StatsScope {
+public:
+    StatsScope(StatsAccount* account) : previous(StatsAccount::current) {
+        StatsAccount::current = account;
+    }
+    ~StatsScope() {
+        StatsAccount::current = previous;
+    }
+    StatsScope(const StatsScope&) = delete;
+private:
+    StatsAccount* previous;
+};
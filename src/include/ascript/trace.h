@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <ostream>
+
+// Execution tracing
+// Events are written as fixed size records into a ring buffer of the thread
+// they happen on, the oldest records are overwritten when it is full.
+// Writing takes no lock, buffers are only registered once per thread.
+
+// Number of records kept per thread
+const size_t TRACE_BUFFER_SIZE = 1 << 16;
+
+struct TraceRecord {
+    enum Event : uint8_t {
+        // Start of a call
+        Enter,
+        // End of a call, also when it raised an error
+        Exit,
+        // Error raised, name is the message
+        Error
+    };
+    enum Category : uint8_t { Script, Native };
+    // Clock ticks, see traceClock
+    uint64_t time;
+    Event event;
+    Category category;
+    uint8_t length;
+    // Function name or error message, truncated
+    char name[53];
+};
+
+// Cheap monotonic clock, cycle counter on x86-64
+uint64_t traceClock();
+
+// Appends a record to the buffer of this thread
+void traceEvent(TraceRecord::Event event, TraceRecord::Category category, const std::string& name);
+
+// Writes the records of all threads in Chrome trace JSON format
+// (chrome://tracing, Perfetto)
+void writeChromeTrace(std::ostream& out);
+
+// Discards the records of all threads
+void clearTrace();
@@ -3,9 +3,14 @@
 #include <memory>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <string>
+#include <string_view>
 #include <functional>
 #include <stdexcept>
+#include <exception>
+
+#include "stats.h"
 
 // Runtime value
 struct Value;
@@ -16,17 +21,38 @@ using valp = std::shared_ptr<Value>;
 struct Stat;
 struct Exp;
 
+class JitFunction;
+struct Module;
+class Script;
+
 // Any statement
 using statp = std::shared_ptr<Stat>;
 // Any expression
 using expp = std::shared_ptr<Exp>;
 // List of expressions
 using expl = std::vector<expp>;
-// Variables (names associated to values)
-using var = std::map<std::string, valp>;
+// Variables (names associated to values), counted in the script heap
+using var = std::map<std::string, valp, std::less<std::string>, HeapAllocator<std::pair<const std::string, valp>>>;
+// Elements of a list, counted in the script heap
+using vallist = std::vector<valp, HeapAllocator<valp>>;
+
+// Iteration over the elements of a value
+struct Iterator {
+    virtual ~Iterator() {}
+    // Returns the next element, null at the end
+    virtual valp next() = 0;
+};
+using iterp = std::unique_ptr<Iterator>;
 
 struct Value {
+    // Counts the value in the stats of the running script
+    Value(ScriptStats::ValueKind kind = ScriptStats::Other) {
+        if (auto a = StatsAccount::current) a->stats.values[kind]++;
+    }
     virtual ~Value() {};
+    // Values allocated with new count in heapBytes of the running script
+    static void* operator new(size_t size) { return heapAlloc(size); }
+    static void operator delete(void* p, size_t size) { heapFree(p, size); }
     // Unary operator
     virtual valp unop(std::string op) ;
     // Binary operator
@@ -34,8 +60,12 @@ struct Value {
     virtual size_t length() ;
     virtual valp at(int id) ;
     virtual valp& atRef(int id) ;
+    // Iterator over elements, the value must outlive it
+    // Default uses length/at
+    virtual iterp iter() ;
     virtual valp get(std::string mem) ;
     virtual valp& getRef(std::string mem) ;
+    // Truth value in conditions, true unless overridden
     virtual bool isTrue() ;
     virtual int getInt() ;
     virtual valp call(std::string f, std::vector<valp> args) ;
@@ -44,13 +74,14 @@ struct Value {
 };
 
 struct ValueNone : public Value {
+    virtual bool isTrue() { return false; }
     virtual std::string print() {
         return "None";
     }
 };
 
 struct ValueInt : public Value {
-    ValueInt(int v) : value(v) {}
+    ValueInt(int v) : Value(ScriptStats::Int), value(v) {}
     virtual valp unop(std::string op);
     virtual valp binop(std::string op, valp r);
     virtual int getInt() { return value; }
@@ -60,31 +91,113 @@ struct ValueInt : public Value {
 };
 
 struct ValueFloat : public Value {
-    ValueFloat(float v) : value(v) {}
+    ValueFloat(float v) : Value(ScriptStats::Float), value(v) {}
     virtual valp unop(std::string op);
     virtual valp binop(std::string op, valp r);
+    virtual bool isTrue() { return value!=0; }
     virtual std::string print();
     float value;
 };
 
 // Names associated to values
 struct ValueMap : public Value {
-    ValueMap(var vars) : vars(vars) {}
+    ValueMap(var vars) : Value(ScriptStats::Map), vars(std::move(vars)) {}
+    // Variables of a map allocated by the host, copied into the script heap
+    template <typename C, typename A>
+    ValueMap(const std::map<std::string, valp, C, A>& vars) : ValueMap(var(vars.begin(), vars.end())) {}
     virtual valp get(std::string mem);
     virtual valp &getRef(std::string mem);
+    // Iterates names
+    virtual iterp iter();
+    // Whether the map has names
+    virtual bool isTrue() { return !vars.empty(); }
     virtual std::string print();
     var vars;
 };
 
+// Imported module variables, loaded on first access
+struct ValueModule : public ValueMap {
+    /* loader = fills the module variables */
+    ValueModule(std::function<void(ValueMap&)> loader) : ValueMap({}), loader(loader) {}
+    virtual valp get(std::string mem);
+    virtual valp &getRef(std::string mem);
+    virtual iterp iter();
+    virtual bool isTrue();
+    virtual std::string print();
+    // Runs loader if the module isn't loaded yet, raises the error of the
+    // loader if it failed
+    void load();
+    std::function<void(ValueMap&)> loader;
+    std::exception_ptr error;
+};
+
 // Vector of values
+// Slices view the elements of the list they were taken from, the elements
+// are copied when either of them is changed
+// Indices below the length that were never assigned are holes, read as None.
+// A list assigned far past its end becomes sparse: its elements are kept by
+// index in a hash map, so that memory follows the number of elements rather
+// than the length. It becomes dense again once half full.
 struct ValueList : public Value {
-    ValueList(std::vector<valp> values) : values(values) {}
+    ValueList(vallist values) : Value(ScriptStats::List), storage(std::allocate_shared<vallist>(HeapAllocator<vallist>(), std::move(values))) {}
+    // Elements of a vector allocated by the host, copied into the script heap
+    template <typename A>
+    ValueList(const std::vector<valp, A>& values) : ValueList(vallist(values.begin(), values.end())) {}
     virtual size_t length();
+    // Element i, None for holes
     virtual valp at(int i);
     virtual valp& atRef(int i);
+    size_t size() const { return sparse ? sparse->length : view ? count : storage->size(); }
+    // Whether the list has elements
+    virtual bool isTrue() { return size() != 0; }
+    // Element i for reading, null for holes
+    const valp& operator[](size_t i) const {
+        if (sparse) {
+            auto it = sparse->elements.find(i);
+            return it == sparse->elements.end() ? hole : it->second;
+        }
+        return view ? (*storage)[offset + i*stride] : (*storage)[i];
+    }
+    // Elements for changing, owned by this list only, sparse lists become dense
+    vallist& values();
+    // Sets the length, elements at n and after are dropped and new indices are holes
+    void resize(size_t n);
+    // Same as resize, the list is made sparse first so that new holes aren't
+    // allocated, for lists then filled by atRef
+    void resizeSparse(size_t n);
+    // Whether elements are kept by index
+    bool isSparse() const { return (bool)sparse; }
+    // Indices of the elements that aren't holes, in increasing order
+    std::vector<size_t> indices() const;
+    // New list viewing count elements from beg, every step elements
+    // Slices of sparse lists are copies
+    valp slice(size_t beg, size_t count, size_t step);
+    /* length()
+       push(v), pop()
+       indices() = indices of the elements that aren't holes
+       slice(beg, end), slice(beg, end, step) = view of elements [beg, end)
+       find(v) = index of first element equal to v, or for which function v is true, -1 if none
+       map(f), filter(f) = new list
+       reduce(f, init) = f(...f(f(init, e0), e1)..., en)
+       sort(), sort(less) and reverse() are in place */
     virtual valp call(std::string f, std::vector<valp> args);
     virtual std::string print();
-    std::vector<valp> values;
+private:
+    // Number of elements that aren't holes
+    size_t stored() const;
+    void makeSparse();
+    void makeDense();
+    std::shared_ptr<vallist> storage;
+    // Set for slices, elements are storage[offset + i*stride] for i < count
+    bool view = false;
+    size_t offset = 0, count = 0, stride = 1;
+    // Set for sparse lists, storage is then unused
+    struct Sparse {
+        std::unordered_map<size_t, valp, std::hash<size_t>, std::equal_to<size_t>, HeapAllocator<std::pair<const size_t, valp>>> elements;
+        size_t length = 0;
+    };
+    std::unique_ptr<Sparse> sparse;
+    static inline const valp hole;
 };
 
 struct ValueRange : public Value {
@@ -95,27 +208,103 @@ struct ValueRange : public Value {
     virtual size_t length();
     virtual valp at(int i);
     virtual valp& atRef(int id);
+    virtual bool isTrue() { return length() != 0; }
     virtual std::string print();
     int beg, end, step;
 };
 
-// String
+// String, owns its bytes or views bytes kept alive by another object
 struct ValueStr : public Value {
-    ValueStr(std::string v) : value(v) {}
+    ValueStr(std::string v) : Value(ScriptStats::Str), value(std::move(v)), data(value.data()), size(value.size()) {
+        chargeBytes();
+    }
+    /* owner = keeps bytes valid
+       data, size = viewed bytes */
+    ValueStr(std::shared_ptr<const void> owner, const char* data, size_t size) : Value(ScriptStats::Str), owner(owner), data(data), size(size) {}
+    ValueStr(const ValueStr&) = delete;
+    ~ValueStr();
+    // + concatenates, comparisons compare bytes
     virtual valp binop(std::string op, valp r);
-    virtual std::string getStr() { return value; }
+    virtual std::string getStr() { return std::string(data, size); }
+    std::string_view view() const { return std::string_view(data, size); }
+    virtual size_t length() { return size; }
+    // Byte i as a string
+    virtual valp at(int i);
+    virtual valp& atRef(int i);
+    // New string of count bytes from beg, viewing the bytes of this string
+    // unless they are short enough to be copied without allocating
+    valp substr(size_t beg, size_t count);
+    // Keeps the viewed bytes valid, null if the string owns its bytes
+    const std::shared_ptr<const void>& bytesOwner() const { return owner; }
+    // Keeps the bytes valid, the bytes of a string owning them are shared first
+    const std::shared_ptr<const void>& share();
+    /* length()
+       find(s), find(s, from) = index of first s at or after from, -1 if none
+       split(sep) = list of the parts between occurrences of sep, as views
+       substr(beg), substr(beg, count) = view of count bytes from beg, up to the end by default
+       startsWith(s)
+       replace(old, new) = new string with every old replaced by new
+       join(list) = elements of list separated by this string, non-strings as printed
+       toInt(), toFloat() = number written in the whole string */
+    virtual valp call(std::string f, std::vector<valp> args);
+    // Whether the string isn't empty
+    virtual bool isTrue() { return size != 0; }
+    // Iterates characters as strings
+    virtual iterp iter();
     virtual std::string print();
+private:
+    // Counts the bytes of value allocated outside the string in the script heap
+    void chargeBytes();
+    // Bytes of owned strings
     std::string value;
+    std::shared_ptr<const void> owner;
+    // Account charged with the bytes of value, null if none or once they are
+    // shared, their owner then credits them
+    StatsAccount* account = nullptr;
+    size_t charged = 0;
+public:
+    const char* data;
+    size_t size;
 };
 
 // Calls script function
+struct NativeCall;
+// Code compiled ahead of time for a script function, see compiled.h
+// Returns false when it can't run the call, the interpreter runs it instead
+typedef bool (*NativeCode)(NativeCall& call, const std::vector<valp>& args, valp& result);
+
 struct ValueFunction : public Value {
     /* args = names of arguments
        body = function body */
-    ValueFunction(std::vector<std::string> args, statp body) : args(args), body(body) {}
+    ValueFunction(std::vector<std::string> args, statp body) : Value(ScriptStats::Function), args(args), body(body) {}
     virtual std::string print();
     std::vector<std::string> args;
     statp body;
+    // Variable or member the function was defined for, empty if none
+    std::string name;
+    // Number of calls, used to find hot functions
+    size_t calls = 0;
+    // Machine code for body, null if not compiled
+    std::shared_ptr<JitFunction> jit;
+    // Set when body can't be compiled
+    bool jitFailed = false;
+    // Code compiled by ascriptc for body, null if none
+    NativeCode native = nullptr;
+    // Script and module the function was defined in, module is null for the main script
+    Script* script = nullptr;
+    Module* module = nullptr;
+    // Set when body contains `yield`, calls then return a ValueGenerator
+    bool generator = false;
+};
+
+// Values produced lazily by a script function containing `yield`
+struct ValueGenerator : public Value {
+    /* next = runs the function until its next value, returns null when it ends */
+    ValueGenerator(std::function<valp()> next) : next(next) {}
+    // Iterates remaining values, can only be iterated once
+    virtual iterp iter();
+    virtual std::string print();
+    std::function<valp()> next;
 };
 
 // Calls native function
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// vec2, vec3 or vec4 of floats, components x, y, z and w
+// Like maps, vectors are shared by the variables they are assigned to and
+// component assignments change them in place
+struct ValueVec : public Value {
+    /* n = number of components, 2 to 4 */
+    ValueVec(int n) : Value(ScriptStats::Vec), n(n) {}
+    // + - * / by a vector of the same size componentwise, * / by a number, == !=
+    virtual valp binop(std::string op, valp r);
+    virtual size_t length() { return n; }
+    virtual valp at(int i);
+    virtual valp get(std::string mem);
+    virtual valp& getRef(std::string mem);
+    /* length() = euclidean length
+       dot(v), cross(v) for vec3, normalize() */
+    virtual valp call(std::string f, std::vector<valp> args);
+    virtual std::string print();
+    int n;
+    // Unused components are 0, aligned for SSE loads
+    alignas(16) float v[4] = {};
+};
+
+// 4x4 matrix of floats, column major
+struct ValueMat : public Value {
+    ValueMat() : Value(ScriptStats::Vec) {}
+    // * by a matrix or a vec4
+    virtual valp binop(std::string op, valp r);
+    virtual size_t length() { return 4; }
+    // Column i as a vec4
+    virtual valp at(int i);
+    /* transpose() */
+    virtual valp call(std::string f, std::vector<valp> args);
+    virtual std::string print();
+    alignas(16) float m[16] = {};
+};
+
+// Vector or matrix viewing native floats, see VecLayout
+struct ValueVecExtern : public Value, public ValueExternBase {
+    /* data = linked floats
+       n = 2 to 4 for a vector, 16 for a matrix */
+    ValueVecExtern(float* data, int n) : data(data), n(n) {}
+    // Copies the components of a vector or matrix of the same size
+    virtual void assign(valp r) override;
+    // Vector or matrix copied from the linked floats
+    virtual valp get() override;
+    // Linked component, for assignments
+    virtual valp& getRef(std::string mem);
+    virtual std::string print();
+    float* data;
+    int n;
+};
+
+// Number of floats of native type T linked as a vector (2 to 4) or a matrix (16)
+// by Script::link, 0 for other types
+// Host structs made of floats are declared with ASCRIPT_VEC_LAYOUT(Type, n)
+template <typename T>
+struct VecLayout {
+    static const int size = 0;
+};
+template <int N>
+struct VecLayout<float[N]> {
+    static_assert((N >= 2 && N <= 4) || N == 16, "Vectors have 2 to 4 floats, matrices 16");
+    static const int size = N;
+};
+#define ASCRIPT_VEC_LAYOUT(T, N) \
+    template <> \
+    struct VecLayout<T> { \
+        static_assert(sizeof(T) == N*sizeof(float), #T " must be made of " #N " floats"); \
+        static const int size = N; \
+    }
+
+// Defines vec2(x, y), vec3(x, y, z), vec4(x, y, z, w), mat4() for the identity
+// and mat4(16 numbers, column major) in vars
+void addVectorFunctions(valp vars);
@@ -0,0 +1,227 @@
+#include <ascript/script.h>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define ASCRIPT_JIT
+#endif
+
+using namespace std;
+
+#ifdef ASCRIPT_JIT
+
+// Raised when a construct can't be compiled
+struct Unsupported {};
+
+// x86-64 code emitter
+// Code is called as int f(const int* args /* rdi */, int* result /* rsi */),
+// expressions leave their value in eax and temporaries go on the stack.
+// rbp keeps the entry stack pointer so exits can drop pending temporaries.
+class Emitter {
+public:
+    Emitter(const vector<string>& args) : args(args) {}
+
+    void body(statp s) {
+        // push rbp; mov rbp, rsp
+        emit({0x55, 0x48, 0x89, 0xE5});
+        stat(s);
+        // falling off the end returns None, let the interpreter do it
+        bail();
+    }
+
+    vector<uint8_t> code;
+
+private:
+    void emit(initializer_list<uint8_t> bytes) {
+        code.insert(code.end(), bytes);
+    }
+    void emit32(int32_t v) {
+        uint8_t b[4];
+        memcpy(b, &v, 4);
+        code.insert(code.end(), b, b+4);
+    }
+    // Emits jump opcode with empty rel32, returns offset to patch
+    size_t jump(initializer_list<uint8_t> op) {
+        emit(op);
+        emit32(0);
+        return code.size();
+    }
+    // Makes jump ending at offset j go to current position
+    void land(size_t j) {
+        int32_t rel = code.size() - j;
+        memcpy(&code[j-4], &rel, 4);
+    }
+    // mov rsp, rbp; pop rbp; ret
+    void leave() {
+        emit({0x48, 0x89, 0xEC, 0x5D, 0xC3});
+    }
+    // xor eax, eax, then leave
+    void bail() {
+        emit({0x31, 0xC0});
+        leave();
+    }
+    // eax = (eax != 0)
+    void toBool() {
+        emit({0x85, 0xC0, 0x0F, 0x95, 0xC0, 0x0F, 0xB6, 0xC0});
+    }
+    // eax = setcc(cmp eax, ecx)
+    void compare(uint8_t setcc) {
+        emit({0x39, 0xC8, 0x0F, setcc, 0xC0, 0x0F, 0xB6, 0xC0});
+    }
+    // Bails out if ecx is 0 or -1
+    void checkDivisor() {
+        emit({0x85, 0xC9});
+        size_t zero = jump({0x0F, 0x85});
+        bail();
+        land(zero);
+        emit({0x83, 0xF9, 0xFF});
+        size_t minus = jump({0x0F, 0x85});
+        bail();
+        land(minus);
+    }
+
+    void stat(statp sp) {
+        if (auto s = dynamic_pointer_cast<ReturnStat>(sp)) {
+            if (!s->e) throw Unsupported();
+            exp(s->e);
+            // mov [rsi], eax; mov eax, 1, then leave
+            emit({0x89, 0x06, 0xB8});
+            emit32(1);
+            leave();
+        }
+        else if (auto s = dynamic_pointer_cast<BlockStat>(sp)) {
+            for (auto ss : s->stats) stat(ss);
+        }
+        else if (auto s = dynamic_pointer_cast<IfStat>(sp)) {
+            exp(s->cond);
+            emit({0x85, 0xC0});
+            size_t els = jump({0x0F, 0x84});
+            stat(s->then);
+            size_t end = jump({0xE9});
+            land(els);
+            stat(s->els);
+            land(end);
+        }
+        else throw Unsupported();
+    }
+
+    void exp(expp ep) {
+        if (auto e = dynamic_pointer_cast<IntExp>(ep)) {
+            emit({0xB8});
+            emit32(e->value);
+        }
+        else if (auto e = dynamic_pointer_cast<IdExp>(ep)) {
+            // arguments are the only variables of a function without assignments
+            int i = 0;
+            while (i < args.size() && args[i] != e->name) i++;
+            if (i == args.size()) throw Unsupported();
+            // mov eax, [rdi + 4*i]
+            emit({0x8B, 0x87});
+            emit32(4*i);
+        }
+        else if (auto e = dynamic_pointer_cast<UnOpExp>(ep)) {
+            exp(e->l);
+            if (e->op == "-") emit({0xF7, 0xD8});
+            else if (e->op == "not") emit({0x85, 0xC0, 0x0F, 0x94, 0xC0, 0x0F, 0xB6, 0xC0});
+            else throw Unsupported();
+        }
+        else if (auto e = dynamic_pointer_cast<BinOpExp>(ep)) {
+            // eax = l, ecx = r
+            exp(e->l);
+            emit({0x50});
+            exp(e->r);
+            emit({0x89, 0xC1, 0x58});
+            auto& op = e->op;
+            if (op == "+") emit({0x01, 0xC8});
+            else if (op == "-") emit({0x29, 0xC8});
+            else if (op == "*") emit({0x0F, 0xAF, 0xC1});
+            else if (op == "/" || op == "%") {
+                checkDivisor();
+                // cdq; idiv ecx
+                emit({0x99, 0xF7, 0xF9});
+                if (op == "%") emit({0x89, 0xD0});
+            }
+            else if (op == "==") compare(0x94);
+            else if (op == "!=") compare(0x95);
+            else if (op == "<") compare(0x9C);
+            else if (op == ">=") compare(0x9D);
+            else if (op == "<=") compare(0x9E);
+            else if (op == ">") compare(0x9F);
+            else throw Unsupported();
+        }
+        else if (auto e = dynamic_pointer_cast<AndExp>(ep)) {
+            // keep l if it is false
+            exp(e->l);
+            emit({0x85, 0xC0});
+            size_t end = jump({0x0F, 0x84});
+            exp(e->r);
+            land(end);
+        }
+        else if (auto e = dynamic_pointer_cast<OrExp>(ep)) {
+            // keep l if it is true
+            exp(e->l);
+            emit({0x85, 0xC0});
+            size_t end = jump({0x0F, 0x85});
+            exp(e->r);
+            land(end);
+        }
+        else if (auto e = dynamic_pointer_cast<TernaryExp>(ep)) {
+            exp(e->cond);
+            emit({0x85, 0xC0});
+            size_t els = jump({0x0F, 0x84});
+            exp(e->then);
+            size_t end = jump({0xE9});
+            land(els);
+            exp(e->els);
+            land(end);
+        }
+        else throw Unsupported();
+    }
+
+    const vector<string>& args;
+};
+
+shared_ptr<JitFunction> JitFunction::compile(ValueFunction& f) {
+    for (auto& a : f.args) {
+        if (a == "this") return nullptr;
+    }
+    Emitter em(f.args);
+    try {
+        em.body(f.body);
+    } catch (Unsupported) {
+        return nullptr;
+    }
+    // Write code to a writable page, then make it executable but read only
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t size = (em.code.size() + page - 1) / page * page;
+    void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return nullptr;
+    memcpy(mem, em.code.data(), em.code.size());
+    if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(mem, size);
+        return nullptr;
+    }
+    shared_ptr<JitFunction> jf(new JitFunction());
+    jf->code = (int (*)(const int*, int*))mem;
+    jf->size = size;
+    return jf;
+}
+
+JitFunction::~JitFunction() {
+    if (code) munmap((void*)code, size);
+}
+
+#else
+
+shared_ptr<JitFunction> JitFunction::compile(ValueFunction& f) {
+    return nullptr;
+}
+
+JitFunction::~JitFunction() {}
+
+#endif
+
+bool JitFunction::run(const int* args, int& result) {
+    return code(args, &result) != 0;
+}
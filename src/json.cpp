@@ -0,0 +1,426 @@
+#include <ascript/script.h>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// Strings of up to this size are copied, longer ones view the document
+static const size_t SHORT_STR = string().capacity();
+// Arrays and objects nested deeper are rejected rather than overflowing the stack
+static const int MAX_DEPTH = 512;
+
+// Length of the run of bytes at p, before end, that need no escaping in a
+// JSON string: not '"', '\\' or a control character
+static size_t plainBytes(const char* p, const char* end) {
+    const char* b = p;
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i space = _mm_set1_epi8(0x1f);
+    for (; p + 16 <= end; p += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)p);
+        __m128i special = _mm_or_si128(_mm_cmpeq_epi8(x, quote), _mm_cmpeq_epi8(x, backslash));
+        // bytes <= 0x1f unsigned
+        special = _mm_or_si128(special, _mm_cmpeq_epi8(_mm_max_epu8(x, space), space));
+        unsigned mask = _mm_movemask_epi8(special);
+        if (mask) return p - b + __builtin_ctz(mask);
+    }
+#endif
+    while (p < end && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20) p++;
+    return p - b;
+}
+
+struct JsonParser {
+    JsonParser(string_view text, shared_ptr<const void> owner)
+        : beg(text.data()), p(text.data()), end(text.data() + text.size()), owner(owner) {}
+
+    [[noreturn]] void fail(const string& what) {
+        throw runtime_error("Invalid JSON at offset " + to_string(p - beg) + ": " + what);
+    }
+
+    void ws() {
+        while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) p++;
+    }
+
+    // Skips c after whitespace
+    void expect(char c) {
+        ws();
+        if (p >= end || *p != c) fail(string("expected '") + c + "'");
+        p++;
+    }
+
+    bool literal(const char* s, size_t n) {
+        if ((size_t)(end - p) < n || memcmp(p, s, n) != 0) return false;
+        p += n;
+        return true;
+    }
+
+    valp value(int depth) {
+        ws();
+        if (p >= end) fail("unexpected end");
+        switch (*p) {
+        case '{': return object(depth + 1);
+        case '[': return array(depth + 1);
+        case '"': return str();
+        case 't': if (literal("true", 4)) return valp(new ValueInt(1)); break;
+        case 'f': if (literal("false", 5)) return valp(new ValueInt(0)); break;
+        case 'n': if (literal("null", 4)) return valp(new ValueNone()); break;
+        default: if (*p == '-' || (*p >= '0' && *p <= '9')) return number();
+        }
+        fail("unexpected character");
+    }
+
+    valp object(int depth) {
+        if (depth > MAX_DEPTH) fail("nested too deep");
+        p++;
+        auto r = new ValueMap({});
+        valp result(r);
+        ws();
+        if (p < end && *p == '}') {
+            p++;
+            return result;
+        }
+        string key;
+        while (true) {
+            ws();
+            if (p >= end || *p != '"') fail("expected a name");
+            string_view view;
+            if (!strBytes(key, view)) key.assign(view);
+            expect(':');
+            // duplicate names keep the last value
+            r->vars.insert_or_assign(key, value(depth));
+            if (next('}')) return result;
+        }
+    }
+
+    valp array(int depth) {
+        if (depth > MAX_DEPTH) fail("nested too deep");
+        p++;
+        vallist items;
+        ws();
+        if (p < end && *p == ']') {
+            p++;
+            return valp(new ValueList(move(items)));
+        }
+        while (true) {
+            items.push_back(value(depth));
+            if (next(']')) return valp(new ValueList(move(items)));
+        }
+    }
+
+    // After an element of an array or object closed by c, whether it was the last one
+    bool next(char c) {
+        ws();
+        if (p < end && *p == ',') {
+            p++;
+            return false;
+        }
+        if (p < end && *p == c) {
+            p++;
+            return true;
+        }
+        fail(string("expected ',' or '") + c + "'");
+    }
+
+    valp str() {
+        string s;
+        string_view view;
+        const char* start = p + 1;
+        if (strBytes(s, view)) return valp(new ValueStr(move(s)));
+        if (owner && view.size() > SHORT_STR) return valp(new ValueStr(owner, start, view.size()));
+        return valp(new ValueStr(string(view)));
+    }
+
+    // Reads the string at p, returns false with its bytes in view if it has no
+    // escapes, else true with the unescaped bytes in out
+    bool strBytes(string& out, string_view& view) {
+        const char* start = ++p;
+        p += plainBytes(p, end);
+        if (p >= end) fail("unterminated string");
+        if (*p == '"') {
+            view = string_view(start, p - start);
+            p++;
+            return false;
+        }
+        out.assign(start, p - start);
+        while (true) {
+            if (p >= end) fail("unterminated string");
+            char c = *p;
+            if (c == '"') {
+                p++;
+                return true;
+            }
+            if ((unsigned char)c < 0x20) fail("control character in string");
+            // c is '\\'
+            if (++p >= end) fail("unterminated string");
+            switch (*p++) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': utf8(out, codePoint()); break;
+            default: p--; fail("unknown escape");
+            }
+            size_t n = plainBytes(p, end);
+            out.append(p, n);
+            p += n;
+        }
+    }
+
+    unsigned hex4() {
+        if (end - p < 4) fail("unterminated escape");
+        unsigned v = 0;
+        for (int i=0;i<4;i++) {
+            char c = *p++;
+            v <<= 4;
+            if (c >= '0' && c <= '9') v |= c - '0';
+            else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+            else fail("invalid escape");
+        }
+        return v;
+    }
+
+    // Code point of the \u escape after "\u", surrogate pairs are combined
+    unsigned codePoint() {
+        unsigned c = hex4();
+        if (c >= 0xd800 && c < 0xdc00) {
+            if (!literal("\\u", 2)) fail("unpaired surrogate");
+            unsigned low = hex4();
+            if (low < 0xdc00 || low >= 0xe000) fail("unpaired surrogate");
+            c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+        } else if (c >= 0xdc00 && c < 0xe000) fail("unpaired surrogate");
+        return c;
+    }
+
+    static void utf8(string& out, unsigned c) {
+        if (c < 0x80) out += (char)c;
+        else if (c < 0x800) {
+            out += (char)(0xc0 | c >> 6);
+            out += (char)(0x80 | (c & 0x3f));
+        } else if (c < 0x10000) {
+            out += (char)(0xe0 | c >> 12);
+            out += (char)(0x80 | (c >> 6 & 0x3f));
+            out += (char)(0x80 | (c & 0x3f));
+        } else {
+            out += (char)(0xf0 | c >> 18);
+            out += (char)(0x80 | (c >> 12 & 0x3f));
+            out += (char)(0x80 | (c >> 6 & 0x3f));
+            out += (char)(0x80 | (c & 0x3f));
+        }
+    }
+
+    valp number() {
+        const char* start = p;
+        if (*p == '-') p++;
+        if (p < end && *p == '0') p++;
+        else if (p < end && *p >= '1' && *p <= '9') {
+            while (p < end && *p >= '0' && *p <= '9') p++;
+        } else fail("invalid number");
+        bool integer = true;
+        if (p < end && *p == '.') {
+            integer = false;
+            p++;
+            if (p >= end || *p < '0' || *p > '9') fail("invalid number");
+            while (p < end && *p >= '0' && *p <= '9') p++;
+        }
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            integer = false;
+            p++;
+            if (p < end && (*p == '+' || *p == '-')) p++;
+            if (p >= end || *p < '0' || *p > '9') fail("invalid number");
+            while (p < end && *p >= '0' && *p <= '9') p++;
+        }
+        if (integer) {
+            int v;
+            auto r = from_chars(start, p, v);
+            if (r.ec == errc()) return valp(new ValueInt(v));
+        }
+        float f;
+        auto r = from_chars(start, p, f);
+        if (r.ec == errc::result_out_of_range) fail("number out of range");
+        return valp(new ValueFloat(f));
+    }
+
+    // Fails unless only whitespace is left
+    void finish() {
+        ws();
+        if (p != end) fail("unexpected character after the document");
+    }
+
+    const char* beg;
+    const char* p;
+    const char* end;
+    shared_ptr<const void> owner;
+};
+
+valp fromJson(string_view text, shared_ptr<const void> owner) {
+    JsonParser parser(text, owner);
+    valp v = parser.value(0);
+    parser.finish();
+    return v;
+}
+
+// Makes room for n more bytes in out, checking the script heap before
+// allocating so that a huge document raises instead of failing to allocate
+static void room(string& out, size_t n) {
+    if (out.capacity() - out.size() >= n) return;
+    size_t cap = max(out.capacity() * 2, out.size() + n);
+    checkHeap(cap + 1);
+    out.reserve(cap);
+}
+
+static void writeStr(string& out, string_view s) {
+    out += '"';
+    const char* p = s.data();
+    const char* end = p + s.size();
+    while (true) {
+        // the plain bytes left, an escape and the closing quote
+        room(out, end - p + 8);
+        size_t n = plainBytes(p, end);
+        out.append(p, n);
+        p += n;
+        if (p >= end) break;
+        char c = *p++;
+        if (c == '"') out += "\\\"";
+        else if (c == '\\') out += "\\\\";
+        else if (c == '\n') out += "\\n";
+        else if (c == '\t') out += "\\t";
+        else if (c == '\r') out += "\\r";
+        else {
+            static const char digits[] = "0123456789abcdef";
+            out += "\\u00";
+            out += digits[(unsigned char)c >> 4];
+            out += digits[c & 15];
+        }
+    }
+    out += '"';
+}
+
+template <typename T>
+static void writeNumber(string& out, T v) {
+    char b[32];
+    auto r = to_chars(b, b + sizeof(b), v);
+    out.append(b, r.ptr);
+}
+
+static void writeFloat(string& out, float f) {
+    if (f != f || f - f != 0) throw runtime_error("Can't write " + to_string(f) + " to JSON");
+    writeNumber(out, f);
+}
+
+// path holds the containers being written to detect cycles
+static void write(string& out, const valp& v, vector<Value*>& path) {
+    // numbers, null and punctuation
+    room(out, 32);
+    if (!v || dynamic_cast<ValueNone*>(v.get())) {
+        out += "null";
+    } else if (auto x = dynamic_cast<ValueInt*>(v.get())) {
+        writeNumber(out, x->value);
+    } else if (auto x = dynamic_cast<ValueFloat*>(v.get())) {
+        writeFloat(out, x->value);
+    } else if (auto x = dynamic_cast<ValueStr*>(v.get())) {
+        writeStr(out, x->view());
+    } else if (auto x = dynamic_cast<ValueVec*>(v.get())) {
+        out += '[';
+        for (int i=0;i<x->n;i++) {
+            if (i) out += ',';
+            writeFloat(out, x->v[i]);
+        }
+        out += ']';
+    } else if (auto x = dynamic_cast<ValueMat*>(v.get())) {
+        out += '[';
+        for (int i=0;i<16;i++) {
+            if (i) out += ',';
+            writeFloat(out, x->m[i]);
+        }
+        out += ']';
+    } else if (dynamic_cast<ValueFunction*>(v.get()) || dynamic_cast<ValueNativeFunc*>(v.get())) {
+        throw runtime_error("Can't write function to JSON");
+    } else if (dynamic_cast<ValueModule*>(v.get())) {
+        throw runtime_error("Can't write module to JSON");
+    } else if (dynamic_cast<ValueList*>(v.get()) || dynamic_cast<ValueMap*>(v.get()) || dynamic_cast<ValueRange*>(v.get())) {
+        if (find(path.begin(), path.end(), v.get()) != path.end()) throw runtime_error("Can't write cyclic value to JSON");
+        path.push_back(v.get());
+        if (auto x = dynamic_cast<ValueMap*>(v.get())) {
+            out += '{';
+            bool first = true;
+            for (auto& e : x->vars) {
+                if (!first) out += ',';
+                first = false;
+                writeStr(out, e.first);
+                out += ':';
+                write(out, e.second, path);
+            }
+            out += '}';
+        } else {
+            out += '[';
+            auto it = v->iter();
+            bool first = true;
+            while (auto e = it->next()) {
+                if (!first) out += ',';
+                first = false;
+                write(out, e, path);
+            }
+            out += ']';
+        }
+        path.pop_back();
+    } else throw runtime_error("Can't write " + v->print() + " to JSON");
+}
+
+void toJson(string& out, const valp& v) {
+    vector<Value*> path;
+    write(out, v, path);
+}
+
+void addJsonFunctions(valp vars) {
+    vars->getRef("parseJson") = valp(new ValueNativeFunc([](vector<valp> a) {
+        if (a.size() != 1 && a.size() != 2) throw runtime_error("Unmatched argument number");
+        auto s = dynamic_pointer_cast<ValueStr>(a[0]);
+        if (!s) throw runtime_error("Expected a string argument");
+        // long strings of the document view its bytes
+        shared_ptr<const void> owner;
+        if (s->size > SHORT_STR) owner = s->share();
+        if (a.size() == 1) return fromJson(s->view(), owner);
+        Callback f(a[1], 1);
+        JsonParser parser(s->view(), owner);
+        int calls = 0;
+        parser.ws();
+        if (parser.p < parser.end && *parser.p == '[') {
+            parser.p++;
+            parser.ws();
+            if (parser.p < parser.end && *parser.p == ']') parser.p++;
+            else {
+                do {
+                    f(parser.value(1));
+                    calls++;
+                } while (!parser.next(']'));
+            }
+        } else {
+            f(parser.value(0));
+            calls++;
+        }
+        parser.finish();
+        return valp(new ValueInt(calls));
+    }));
+    vars->getRef("toJson") = valp(new ValueNativeFunc([](vector<valp> a) {
+        if (a.size() != 1) throw runtime_error("Unmatched argument number");
+        // reserved like the last result so that writing rarely grows it, then
+        // moved into the string without copying
+        thread_local size_t lastSize = 0;
+        string out;
+        room(out, lastSize);
+        toJson(out, a[0]);
+        lastSize = out.size();
+        return valp(new ValueStr(move(out)));
+    }));
+}
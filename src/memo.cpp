@@ -0,0 +1,121 @@
+#include <ascript/script.h>
+#include <cstring>
+
+using namespace std;
+
+// Cached results of memoize(f) without capacity
+static const size_t DEFAULT_CAPACITY = 4096;
+
+template <typename T>
+static void appendBytes(string& key, const T& v) {
+    key.append((const char*)&v, sizeof(v));
+}
+
+// Appends the content of v to key, returns false if v can't be a key
+static bool appendKey(string& key, const valp& v) {
+    if (auto x = dynamic_cast<ValueInt*>(v.get())) {
+        key += 'i';
+        appendBytes(key, x->value);
+    } else if (auto x = dynamic_cast<ValueFloat*>(v.get())) {
+        key += 'f';
+        // -0 and 0 are equal
+        appendBytes(key, x->value == 0 ? 0.0f : x->value);
+    } else if (auto x = dynamic_cast<ValueStr*>(v.get())) {
+        key += 's';
+        appendBytes(key, x->size);
+        key.append(x->data, x->size);
+    } else if (auto x = dynamic_cast<ValueList*>(v.get())) {
+        if (x->isSparse()) {
+            // elements by index, as many as stored
+            key += 'p';
+            appendBytes(key, x->size());
+            auto indices = x->indices();
+            appendBytes(key, indices.size());
+            for (size_t i : indices) {
+                appendBytes(key, i);
+                if (!appendKey(key, (*x)[i])) return false;
+            }
+            return true;
+        }
+        key += 'l';
+        appendBytes(key, x->size());
+        for (size_t i=0;i<x->size();i++) {
+            if (!appendKey(key, (*x)[i])) return false;
+        }
+    } else if (!v || dynamic_cast<ValueNone*>(v.get())) {
+        key += 'n';
+    } else return false;
+    return true;
+}
+
+ValueMemo::ValueMemo(valp f, size_t capacity)
+    : ValueNativeFunc([this](vector<valp> args) { return lookup(args); }), function(f), capacity(capacity) {
+    if (!dynamic_pointer_cast<ValueFunction>(f) && !dynamic_pointer_cast<ValueNativeFunc>(f)) {
+        throw runtime_error("Can't memoize non-function");
+    }
+}
+
+valp ValueMemo::lookup(const vector<valp>& args) {
+    auto a = StatsAccount::current;
+    string key;
+    bool keyed = true;
+    for (auto& v : args) {
+        if (!(keyed = appendKey(key, v))) break;
+    }
+    if (keyed) {
+        auto it = index.find(key);
+        if (it != index.end()) {
+            hits++;
+            if (a) a->stats.memoHits++;
+            entries.splice(entries.begin(), entries, it->second);
+            return it->second->result;
+        }
+    }
+    misses++;
+    if (a) a->stats.memoMisses++;
+    // a new callback per call, recursive calls then have their own
+    Callback f(function, args.size());
+    valp result = f(args);
+    if (!keyed) return result;
+    // recursive calls may have cached it meanwhile
+    auto it = index.find(key);
+    if (it != index.end()) {
+        it->second->result = result;
+        entries.splice(entries.begin(), entries, it->second);
+        return result;
+    }
+    entries.push_front({move(key), result});
+    index.emplace(entries.front().key, entries.begin());
+    if (entries.size() > capacity) {
+        index.erase(entries.back().key);
+        entries.pop_back();
+    }
+    return result;
+}
+
+valp ValueMemo::call(string f, vector<valp> args) {
+    if (args.size() == 0) {
+        if (f == "hits") return valp(new ValueInt(hits));
+        if (f == "misses") return valp(new ValueInt(misses));
+        if (f == "size") return valp(new ValueInt(entries.size()));
+        if (f == "clear") {
+            index.clear();
+            entries.clear();
+            return valp(new ValueNone());
+        }
+    }
+    throw runtime_error("Unknown method");
+}
+
+string ValueMemo::print() {
+    return "memoized " + function->print();
+}
+
+void addMemoFunctions(valp vars) {
+    vars->getRef("memoize") = valp(new ValueNativeFunc([](vector<valp> a) {
+        if (a.size() != 1 && a.size() != 2) throw runtime_error("Unmatched argument number");
+        int capacity = a.size() == 2 ? a[1]->getInt() : DEFAULT_CAPACITY;
+        if (capacity <= 0) throw runtime_error("Memoize capacity must be positive");
+        return valp(new ValueMemo(a[0], capacity));
+    }));
+}
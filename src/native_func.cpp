@@ -48,6 +48,35 @@ float convert(valp a) {
 
 template<>
 string convert(valp a) {
-    if (auto a0 = dynamic_pointer_cast<ValueStr>(a)) return a0->value;
+    if (auto a0 = dynamic_pointer_cast<ValueStr>(a)) return a0->getStr();
     throw runtime_error("Unmatched argument types");
-}
\ No newline at end of file
+}
+
+// Views the bytes of the argument, valid during the call
+template<>
+string_view convert(valp a) {
+    if (auto a0 = dynamic_pointer_cast<ValueStr>(a)) return a0->view();
+    throw runtime_error("Unmatched argument types");
+}
+
+template <>
+void setArg(valp& v, int a) {
+    if (v.use_count() == 1) {
+        if (auto i = dynamic_cast<ValueInt*>(v.get())) {
+            i->value = a;
+            return;
+        }
+    }
+    v = convertRet(a);
+}
+
+template <>
+void setArg(valp& v, float a) {
+    if (v.use_count() == 1) {
+        if (auto f = dynamic_cast<ValueFloat*>(v.get())) {
+            f->value = a;
+            return;
+        }
+    }
+    v = convertRet(a);
+}
@@ -0,0 +1,145 @@
+#include <ascript/script.h>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+
+// Function definitions of code in a stable order, see snapshot.cpp
+void listFunctions(statp code, vector<FuncDefExp*>& funcs);
+// Load AST and source from file, see script.cpp
+statp loadCode(string path, shared_ptr<const Source>& source);
+// Whether function body contains `yield`
+bool hasYield(statp body);
+// path of a module as modules stores it, see script.cpp
+string normalPath(const string& path);
+
+// Function definition, found again in another version of its file by key
+struct Definition {
+    FuncDefExp* e;
+    // Enclosing definition, -1 at the top level
+    int parent;
+    // Names of the enclosing definitions and of the definition, numbered by
+    // order among the definitions of the same name in the same parent
+    string key;
+    string_view text;
+    bool nested = false;
+};
+
+static vector<Definition> definitions(statp code, const Source& source) {
+    vector<FuncDefExp*> funcs;
+    listFunctions(code, funcs);
+    vector<Definition> defs;
+    map<pair<int, string>, int> counts;
+    // Definitions containing the current one, innermost last
+    vector<int> open;
+    for (auto e : funcs) {
+        auto& info = e->srcinfo;
+        // a definition is listed right before the ones it contains
+        while (!open.empty()) {
+            auto& o = defs[open.back()].e->srcinfo;
+            if (o.start_index <= info.start_index && info.start_index <= o.end_index) break;
+            open.pop_back();
+        }
+        int parent = open.empty() ? -1 : open.back();
+        if (parent >= 0) defs[parent].nested = true;
+        string name = e->name.empty() ? "function" : e->name;
+        int n = counts[{parent, name}]++;
+        Definition d;
+        d.e = e;
+        d.parent = parent;
+        d.key = (parent >= 0 ? defs[parent].key : "") + "/" + name + "#" + to_string(n);
+        d.text = string_view(source.text).substr(info.start_index, info.end_index + 1 - info.start_index);
+        open.push_back(defs.size());
+        defs.push_back(move(d));
+    }
+    return defs;
+}
+
+void Script::reload(string path) {
+    Module* m = nullptr;
+    if (path != filename) {
+        auto it = modules.find(normalPath(path));
+        if (it == modules.end()) throw runtime_error("Can't reload " + path + ", it isn't loaded");
+        m = it->second.get();
+        // modules not used yet read their file when first used
+        if (!m->code) return;
+    }
+    statp& code = m ? m->code : this->code;
+    auto& source = m ? m->source : this->source;
+    valp vars = m ? m->variables : variables;
+
+    StatsScope scope(account);
+    shared_ptr<const Source> newSource;
+    statp newCode = loadCode(path, newSource);
+    auto defs = definitions(code, *source);
+    auto newDefs = definitions(newCode, *newSource);
+
+    unordered_map<string_view, const Definition*> byKey;
+    for (auto& d : defs) byKey[d.key] = &d;
+    for (auto& d : newDefs) {
+        auto it = byKey.find(d.key);
+        if (it == byKey.end()) continue;
+        auto& old = *it->second;
+        Stat* body = old.e->body.get();
+        bool same = old.text == d.text;
+        // functions created from the old body now run the new one, in place
+        // so that variables, lists and native handles holding them see the change
+        auto fs = functions.find(body);
+        if (fs != functions.end()) {
+            auto rebound = move(fs->second);
+            functions.erase(fs);
+            auto& list = functions[d.e->body.get()];
+            for (auto& w : rebound) {
+                auto f = w.lock();
+                if (!f) continue;
+                f->args = d.e->args;
+                f->body = d.e->body;
+                f->native = d.e->native;
+                if (!same) {
+                    f->generator = hasYield(f->body);
+                    f->calls = 0;
+                    f->jit = nullptr;
+                    f->jitFailed = false;
+                }
+                list.push_back(f);
+            }
+        }
+        // closures keep the positions and nested definitions they were compiled from
+        auto c = compiled.find(body);
+        if (c != compiled.end()) {
+            if (same && !old.nested && old.e->srcinfo.start_index == d.e->srcinfo.start_index
+                    && old.e->srcinfo.line == d.e->srcinfo.line) {
+                compiled[d.e->body.get()] = {d.e->body, move(c->second.run)};
+            }
+        }
+    }
+    // no old body is used by new functions, removed definitions included
+    for (auto& d : defs) {
+        compiled.erase(d.e->body.get());
+        functions.erase(d.e->body.get());
+    }
+
+    // the code outside functions isn't run again, only the assignments of
+    // functions added at the top level are
+    unordered_set<FuncDefExp*> added;
+    for (auto& d : newDefs) {
+        if (d.parent < 0 && !byKey.count(d.key)) added.insert(d.e);
+    }
+    auto b = dynamic_pointer_cast<BlockStat>(newCode);
+    if (b && !added.empty()) {
+        Module* current = module;
+        module = m;
+        for (auto& s : b->stats) {
+            auto a = dynamic_pointer_cast<AssignStat>(s);
+            auto id = a ? dynamic_pointer_cast<IdExp>(a->left) : nullptr;
+            auto e = id ? dynamic_pointer_cast<FuncDefExp>(a->right) : nullptr;
+            if (e && added.count(e.get())) vars->getRef(id->name) = makeFunction(e->args, e->body, e->name, e->native);
+        }
+        module = current;
+    }
+
+    compiled.erase(code.get());
+    code = newCode;
+    source = newSource;
+}
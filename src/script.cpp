@@ -1,6 +1,13 @@
 #include <ascript/script.h>
+#include <ascript/compiled.h>
 #include <istream>
+#include <fstream>
 #include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <dlfcn.h>
+#include <sys/mman.h>
 
 #include <antlr4-runtime/antlr4-runtime.h>
 #include "parser/ASParser.h"
@@ -10,33 +17,182 @@ using namespace std;
 
 // Extract AST from antlr context
 statp toAST(ASParser::FileContext *file); 
+// Whether function body contains `yield`
+bool hasYield(statp body);
 
-// Load AST from file
-void Script::load(string path) {
-    ifstream stream(path);
-    antlr4::ANTLRInputStream input(stream);
+// Keeps the syntax errors reported by the lexer and parser of source
+struct SyntaxErrorListener : public antlr4::BaseErrorListener {
+    SyntaxErrorListener(shared_ptr<const Source> source) : source(source) {}
+    virtual void syntaxError(antlr4::Recognizer*, antlr4::Token* offendingSymbol, size_t line,
+        size_t charPositionInLine, const string& msg, exception_ptr) override {
+        SourceInfo srcinfo;
+        srcinfo.line = line;
+        srcinfo.column = charPositionInLine;
+        srcinfo.start_index = srcinfo.end_index = 0;
+        if (offendingSymbol && offendingSymbol->getStopIndex() >= offendingSymbol->getStartIndex()) {
+            srcinfo.start_index = offendingSymbol->getStartIndex();
+            srcinfo.end_index = offendingSymbol->getStopIndex();
+        }
+        errors.emplace_back(source, srcinfo, msg);
+    }
+    shared_ptr<const Source> source;
+    vector<InterpreterError> errors;
+};
+
+// Lexer and parser are created for each source so that sources can be
+// parsed on several threads at once
+statp parse(shared_ptr<const Source> source) {
+    antlr4::ANTLRInputStream input(source->text);
     ASLexer lexer(&input);
     antlr4::CommonTokenStream tokens(&lexer);
     ASParser parser(&tokens);
+    SyntaxErrorListener listener(source);
+    lexer.removeErrorListeners();
+    lexer.addErrorListener(&listener);
+    parser.removeErrorListeners();
+    parser.addErrorListener(&listener);
     ASParser::FileContext* tree = parser.file();
+    // the parser recovers to report the following errors, its tree is incomplete
+    if (!listener.errors.empty()) throw LoadError(move(listener.errors));
+    return toAST(tree);
+}
+
+// Scripts compiled ahead of time, by filename
+static map<string, const CompiledScript*>& compiledScripts() {
+    static map<string, const CompiledScript*> scripts;
+    return scripts;
+}
+
+bool registerCompiledScript(const CompiledScript* script) {
+    compiledScripts()[script->filename] = script;
+    return true;
+}
+
+// Returns contents of file at path, empty if it can't be read
+static string readFile(const string& path) {
+    ifstream stream(path, ios::binary | ios::ate);
+    string text;
+    auto size = stream.tellg();
+    if (size > 0) {
+        text.resize(size);
+        stream.seekg(0);
+        stream.read(&text[0], size);
+        text.resize(stream.gcount());
+    }
+    return text;
+}
+
+// Load AST and source from file, or from the compiled script registered under path
+statp loadCode(string path, shared_ptr<const Source>& source) {
+    auto it = compiledScripts().find(path);
+    if (it != compiledScripts().end()) {
+        source = make_shared<Source>(path, it->second->source);
+        return it->second->build();
+    }
+    source = make_shared<Source>(path, readFile(path));
+    return parse(source);
+}
 
-    stringstream ss;
-    stream.seekg(0);
-    ss << stream.rdbuf();
-    this->source = ss.str();
+void Script::load(string path) {
     this->filename = path;
-    code = toAST(tree);
+    code = loadCode(path, source);
 }
 
 Script::Script(string path) {
+    addBuiltins();
+    StatsScope scope(account);
+    try {
+        load(path);
+    } catch (...) {
+        // freed with the builtins, as by the destructor
+        if (account->release()) delete account;
+        throw;
+    }
+}
+
+Script::Script(shared_ptr<const Source> source, statp code, StatsAccount* account)
+    : account(account), code(code), source(source), filename(source->filename) {
+    addBuiltins();
+}
+
+void Script::addBuiltins() {
+    StatsScope scope(account);
     variables->getRef("assert") = valp(new ValueNativeFunc([](auto a) {
         if (!a[0]->isTrue()) throw runtime_error("Assertion failed");
         return valp(new ValueNone());
     }));
-    load(path);
+    addFileFunctions(variables);
+    addVectorFunctions(variables);
+    addJsonFunctions(variables);
+    addMemoFunctions(variables);
+}
+
+vector<unique_ptr<Script>> Script::loadAll(const vector<string>& paths, size_t threads) {
+    if (threads == 0) threads = max(thread::hardware_concurrency(), 1u);
+    threads = min(threads, paths.size());
+    vector<shared_ptr<const Source>> sources(paths.size());
+    vector<statp> codes(paths.size());
+    vector<vector<InterpreterError>> errors(paths.size());
+    // the AST of each file counts in the heap of its script
+    vector<StatsAccount*> accounts(paths.size());
+    for (auto& a : accounts) a = new StatsAccount();
+    // workers take the next file until none is left, so that a long file
+    // doesn't hold back the others
+    atomic<size_t> next{0};
+    auto work = [&]() {
+        for (size_t i=next++;i<paths.size();i=next++) {
+            StatsScope scope(accounts[i]);
+            try {
+                codes[i] = loadCode(paths[i], sources[i]);
+            } catch (LoadError& e) {
+                errors[i] = e.errors();
+            } catch (exception& e) {
+                errors[i].emplace_back(sources[i], SourceInfo(), e.what());
+            }
+        }
+    };
+    vector<thread> workers;
+    for (size_t i=1;i<threads;i++) workers.emplace_back(work);
+    work();
+    for (auto& w : workers) w.join();
+
+    vector<InterpreterError> all;
+    for (auto& e : errors) all.insert(all.end(), e.begin(), e.end());
+    if (!all.empty()) {
+        codes.clear();
+        for (auto a : accounts) delete a;
+        throw LoadError(move(all));
+    }
+    vector<unique_ptr<Script>> scripts;
+    scripts.reserve(paths.size());
+    for (size_t i=0;i<paths.size();i++) {
+        scripts.emplace_back(new Script(sources[i], move(codes[i]), accounts[i]));
+    }
+    return scripts;
+}
+
+Script::~Script() {
+    // values kept by the host keep the account until they are freed
+    if (account->release()) delete account;
+    for (auto& s : freeStacks) munmap(s.base, s.size);
+}
+
+ScriptStats Script::stats() const {
+    auto s = account->stats;
+    s.heapBytes = account->heapBytes();
+    return s;
+}
+
+void Script::setMemoryLimits(size_t soft, size_t hard, function<void(size_t)> onSoftLimit) {
+    account->softLimit = soft ? soft : INT64_MAX;
+    account->hardLimit = hard ? hard : INT64_MAX;
+    account->onSoftLimit = onSoftLimit;
+    account->softLimitReached = false;
+    account->updateWatermark();
 }
 
 void Script::exec(valp vars,statp sp) {
+    account->stats.statements++;
     try {
         if (auto s = dynamic_pointer_cast<AssignStat>(sp)) {
             // eval right side
@@ -57,7 +213,13 @@ void Script::exec(valp vars,statp sp) {
             // get reference to left side
             auto& v = evalRef(vars, s->left);
             string op(1, s->op[0]);
-            v = v->binop(op, r);
+            // Specialization for extern values
+            if (auto vv = dynamic_pointer_cast<ValueExternBase>(v)) {
+                vv->assign(vv->get()->binop(op, r));
+            } else {
+                if (!v) throw runtime_error("Index is a hole");
+                v = v->binop(op, r);
+            }
         }
         else if (auto s = dynamic_pointer_cast<FuncCallStat>(sp)) {
             expp fce = expp(new FuncCallExp(s->ctx, s->f, s->a));
@@ -89,23 +251,35 @@ void Script::exec(valp vars,statp sp) {
         }
         else if (auto s = dynamic_pointer_cast<ForStat>(sp)) {
             auto list = eval(vars, s->list);
-            for (int i=0;i<list->length();i++) {
-                vars->getRef(s->id) = list->at(i);
+            auto it = list->iter();
+            while (auto v = it->next()) {
+                vars->getRef(s->id) = v;
                 exec(vars, s->stat);
                 // stop loop if return stat executed
                 if (ret) return;
             }
         }
         else if (auto s = dynamic_pointer_cast<ReturnStat>(sp)) {
-            if (s->e) {
+            auto call = dynamic_pointer_cast<FuncCallExp>(s->e);
+            if (call && depth > 0) {
+                // `return f(...)` inside a function, the call may reuse the current frame
+                ret = evalCall(vars, call, true);
+                if (!ret) ret = valp(new ValueNone());
+            } else if (s->e) {
                 ret = eval(vars, s->e);
             } else {
                 ret = valp(new ValueNone());
             }
         }
+        else if (auto s = dynamic_pointer_cast<YieldStat>(sp)) {
+            yield(eval(vars, s->e));
+        }
+        else if (auto s = dynamic_pointer_cast<ImportStat>(sp)) {
+            vars->getRef(s->name) = import(s->path);
+        }
         else throw runtime_error("Unknown statement");
     } catch (runtime_error e) {
-        throw InterpreterError(filename, source, sp->srcinfo, e.what());
+        throw error(sp->srcinfo, e.what());
     }
 }
 
@@ -114,32 +288,209 @@ valp Script::evalFunc(valp ctx, string fn, vector<valp> args) {
     auto f0 = ctx->getRef(fn);
     if (auto f = dynamic_pointer_cast<ValueFunction>(f0)) {
         // In case of script function
-        // Check argument number
-        if (f->args.size() != args.size()) throw runtime_error("Unmatching arguments");
-        // place arguments in a map associated with argument names
-        valp env = valp(new ValueMap({}));
-        for (int i=0;i<f->args.size();i++) {
-            auto argName = f->args[i];
-            if (argName == "this") throw runtime_error("Argument can't be named `this`");
-            env->getRef(argName) = args[i];
-        }
-        // link `this`
-        env->getRef("this") = ctx;
-        // run function
-        exec(env, f->body);
-        // extract return value
-        auto v = ret;
-        if (!v) v = valp(new ValueNone());
-        // as we come back to the underlying code reset return indicator
-        ret = nullptr;
-        return v;
+        return callFunction(ctx, f, args);
     } else if (auto f = dynamic_pointer_cast<ValueNativeFunc>(f0)) {
         // in case of native function
         // run function and get return value
+        account->stats.nativeCalls++;
+        if (tracing) return traceNative(fn, [&] { return f->f(args); });
         return f->f(args);
     } else throw runtime_error("Can't call non-function");
 }
 
+valp Script::callFunction(valp ctx, shared_ptr<ValueFunction> f, vector<valp> args) {
+    // Check argument number
+    if (f->args.size() != args.size()) throw runtime_error("Unmatching arguments");
+    if (f->generator) return makeGenerator(ctx, f, args);
+    valp result;
+    if (f->native && runNative(*f, args, result)) return result;
+    if (jitEnabled && runJit(*f, args, result)) return result;
+    return invoke(ctx, f, args);
+}
+
+bool Script::runJit(ValueFunction& f, const vector<valp>& args, valp& result) {
+    // Compile hot functions
+    if (!f.jit && !f.jitFailed && ++f.calls >= jitThreshold) {
+        f.jit = JitFunction::compile(f);
+        f.jitFailed = !f.jit;
+    }
+    if (!f.jit) return false;
+    // Run machine code if all arguments are ints
+    vector<int> iargs;
+    for (auto a : args) {
+        auto i = dynamic_pointer_cast<ValueInt>(a);
+        if (!i) return false;
+        iargs.push_back(i->value);
+    }
+    int r;
+    if (tracing) traceEvent(TraceRecord::Enter, TraceRecord::Script, f.name);
+    bool done = f.jit->run(iargs.data(), r);
+    if (tracing) traceEvent(TraceRecord::Exit, TraceRecord::Script, f.name);
+    if (!done) return false;
+    result = valp(new ValueInt(r));
+    account->stats.scriptCalls++;
+    return true;
+}
+
+bool Script::runNative(ValueFunction& f, const vector<valp>& args, valp& result) {
+    // native calls nest on the current stack, within the budget of interpreted calls
+    char here;
+    if (depth == 0) stackLimit = (uintptr_t)&here - maxStackSize;
+    else if ((uintptr_t)&here < stackLimit) return false;
+    NativeCall c{this, f.module, depth, maxCallDepth, stackLimit};
+    if (tracing) traceEvent(TraceRecord::Enter, TraceRecord::Script, f.name);
+    bool done = f.native(c, args, result);
+    if (tracing) traceEvent(TraceRecord::Exit, TraceRecord::Script, f.name);
+    if (!done) return false;
+    account->stats.scriptCalls += c.calls + 1;
+    return true;
+}
+
+ValueFunction* Script::nativeCallee(Module* module, const string& name) {
+    // global call from a function, as callWithArgs finds it
+    if (module) {
+        auto it = module->variables->vars.find(name);
+        if (it != module->variables->vars.end()) return dynamic_cast<ValueFunction*>(it->second.get());
+    }
+    auto& vars = static_cast<ValueMap*>(variables.get())->vars;
+    auto it = vars.find(name);
+    return it == vars.end() ? nullptr : dynamic_cast<ValueFunction*>(it->second.get());
+}
+
+NativeCallee::Mode NativeCallee::enter(const string& name, NativeCode code) {
+    auto f = c.script->nativeCallee(c.module, name);
+    if (!f || f->native != code) return Bail;
+    this->name = &name;
+    char here;
+    if (c.depth >= c.maxDepth || (uintptr_t)&here < c.stackLimit) return Interpreted;
+    c.module = f->module;
+    c.depth++;
+    c.calls++;
+    entered = true;
+    return Native;
+}
+
+valp NativeCallee::interpret(vector<valp> args) {
+    auto& s = *c.script;
+    valp ctx = module && module->variables->vars.count(*name) ? module->variables : s.variables;
+    auto f = static_pointer_cast<ValueFunction>(ctx->getRef(*name));
+    // calls nested in native code count in the depth of the interpreter
+    size_t depth = s.depth;
+    s.depth = c.depth;
+    try {
+        valp v = s.callFunction(ctx, f, move(args));
+        s.depth = depth;
+        return v;
+    } catch (...) {
+        s.depth = depth;
+        throw;
+    }
+}
+
+bool NativeCallee::same(NativeCall& c, const string& name, NativeCode code) {
+    auto f = c.script->nativeCallee(c.module, name);
+    if (!f || f->native != code) return false;
+    c.calls++;
+    return true;
+}
+
+valp Script::invoke(valp ctx, shared_ptr<ValueFunction> f, vector<valp> args, valp env) {
+    // Check depth and native stack usage (stack grows downwards)
+    char here;
+    if (depth == 0) stackLimit = (uintptr_t)&here - maxStackSize;
+    else if (depth >= maxCallDepth) throw runtime_error("Stack overflow: maximum call depth exceeded");
+    else if ((uintptr_t)&here < stackLimit) return invokeOnNewStack(ctx, f, move(args), env);
+    depth++;
+    // Run in the module the function was defined in
+    Module* caller = module;
+    try {
+        while (true) {
+            account->stats.scriptCalls++;
+            if (tracing) traceEvent(TraceRecord::Enter, TraceRecord::Script, f->name);
+            module = f->module;
+            // place arguments in a map associated with argument names
+            if (!env) env = valp(new ValueMap({}));
+            for (int i=0;i<f->args.size();i++) {
+                auto argName = f->args[i];
+                if (argName == "this") throw runtime_error("Argument can't be named `this`");
+                env->getRef(argName) = args[i];
+            }
+            // link `this`
+            env->getRef("this") = ctx;
+            // run function
+            run(env, f->body);
+            if (tracing) traceEvent(TraceRecord::Exit, TraceRecord::Script, f->name);
+            if (!tailCall) break;
+            // `return g(...)` was executed, run g in place of the current call
+            ctx = tailCall->ctx;
+            f = tailCall->f;
+            args = move(tailCall->args);
+            env = nullptr;
+            tailCall = nullptr;
+            ret = nullptr;
+        }
+    } catch (...) {
+        if (tracing) traceEvent(TraceRecord::Exit, TraceRecord::Script, f->name);
+        depth--;
+        tailCall = nullptr;
+        module = caller;
+        throw;
+    }
+    depth--;
+    module = caller;
+    // extract return value
+    auto v = ret;
+    if (!v) v = valp(new ValueNone());
+    // as we come back to the underlying code reset return indicator
+    ret = nullptr;
+    return v;
+}
+
+// Evaluates function call e; if tail is set, calls to script functions are
+// stored in tailCall instead of being run and null is returned
+valp Script::evalCall(valp vars, shared_ptr<FuncCallExp> e, bool tail) {
+    try {
+        // extract args
+        vector<valp> args;
+        for (auto a : e->a) {
+            args.push_back(eval(vars, a));
+        }
+        // Get context
+        valp vctx = e->ctx ? eval(vars, e->ctx) : nullptr;
+        return callWithArgs(vars, *e, vctx, args, tail);
+    } catch (runtime_error e2) {
+        throw error(e->srcinfo, e2.what());
+    }
+}
+
+// Calls e.f from context vctx with evaluated args, null vctx calls e.f globally
+valp Script::callWithArgs(valp vars, const FuncCallExp& e, valp vctx, vector<valp>& args, bool tail) {
+    // if no context call function globally
+    if (!vctx) {
+        if (dynamic_pointer_cast<ValueFunction>(vars->getRef(e.f))) vctx = vars;
+        else if (module && module->variables->vars.count(e.f)) vctx = module->variables;
+        else vctx = variables;
+    } else if (!dynamic_pointer_cast<ValueMap>(vctx)) {
+        // If not a map find method
+        account->stats.nativeCalls++;
+        if (tracing) return traceNative(e.f, [&] { return vctx->call(e.f, args); });
+        return vctx->call(e.f, args);
+    }
+    // If context is a map call function
+    auto f = dynamic_pointer_cast<ValueFunction>(vctx->getRef(e.f));
+    // generator functions return immediately, there is no frame to reuse
+    if (f && tail && !f->generator) {
+        if (f->args.size() != args.size()) throw runtime_error("Unmatching arguments");
+        // native code doesn't grow the interpreter stack
+        valp result;
+        if (f->native && runNative(*f, args, result)) return result;
+        tailCall.reset(new TailCall{vctx, f, move(args)});
+        return nullptr;
+    }
+    if (f) return callFunction(vctx, f, args);
+    return evalFunc(vctx, e.f, args);
+}
+
 valp Script::eval1(valp vars, expp ep) {
      if (auto e = dynamic_pointer_cast<IntExp>(ep)) {
         return valp(new ValueInt(e->value));
@@ -180,25 +531,7 @@ valp Script::eval1(valp vars, expp ep) {
         return valp(new ValueRange(beg->getInt(), end->getInt(), step->getInt()));
     }
     else if (auto e = dynamic_pointer_cast<FuncCallExp>(ep)) {
-        // extract args
-        vector<valp> args;
-        for (auto a : e->a) {
-            args.push_back(eval(vars, a));
-        }
-        // if no context call function globally
-        if (!e->ctx) {
-            if (dynamic_pointer_cast<ValueFunction>(vars->getRef(e->f))) return evalFunc(vars, e->f, args);
-            else return evalFunc(variables, e->f, args);
-        }
-        // Get context
-        valp vctx = eval(vars, e->ctx);
-        // If context is a map call function
-        if (dynamic_pointer_cast<ValueMap>(vctx)) {
-            return evalFunc(vctx, e->f, args);
-        // If not a map find method
-        } else {
-            return vctx->call(e->f, args);
-        }
+        return evalCall(vars, e, false);
     }
     else if (auto e = dynamic_pointer_cast<StrExp>(ep)) {
         return valp(new ValueStr(e->v));
@@ -208,8 +541,18 @@ valp Script::eval1(valp vars, expp ep) {
         if (vcond->isTrue()) return eval(vars, e->then);
         else return eval(vars, e->els);
     }
+    else if (auto e = dynamic_pointer_cast<AndExp>(ep)) {
+        auto l = eval(vars, e->l);
+        if (!l->isTrue()) return l;
+        return eval(vars, e->r);
+    }
+    else if (auto e = dynamic_pointer_cast<OrExp>(ep)) {
+        auto l = eval(vars, e->l);
+        if (l->isTrue()) return l;
+        return eval(vars, e->r);
+    }
     else if (auto e = dynamic_pointer_cast<FuncDefExp>(ep)) {
-        return valp(new ValueFunction(e->args, e->body));
+        return makeFunction(e->args, e->body, e->name, e->native);
     }
     else if (auto e = dynamic_pointer_cast<IndexExp>(ep)) {
         auto lv = eval(vars, e->l);
@@ -233,7 +576,7 @@ valp Script::eval(valp vars, expp ep) {
             return v;
         }
     } catch (runtime_error e) {
-        throw InterpreterError(filename, source, ep->srcinfo, e.what());
+        throw error(ep->srcinfo, e.what());
     }
 }
 
@@ -244,21 +587,242 @@ valp& Script::evalRef(valp vars, expp lp) {
             return vars->getRef(l->name);
         } else if (auto l = dynamic_pointer_cast<IndexExp>(lp)) {
             auto l0 = evalRef(vars, l->l);
+            if (!l0) throw runtime_error("Index is a hole");
             return l0->atRef(eval(vars, l->i)->getInt());
         } else if (auto l = dynamic_pointer_cast<MemberExp>(lp)) {
             auto l0 = evalRef(vars, l->l);
+            if (!l0) throw runtime_error("Index is a hole");
             return l0->getRef(l->member);
         }
         throw runtime_error("Can't get ref from this exp");
     } catch (runtime_error e) {
-        throw InterpreterError(filename, source, lp->srcinfo, e.what());
+        throw error(lp->srcinfo, e.what());
     }
 }
 
 void Script::run() {
-    exec(variables, code);
+    StatsScope scope(account);
+    run(variables, code);
+}
+
+shared_ptr<ValueFunction> Script::findFunction(string name) {
+    auto& vars = static_pointer_cast<ValueMap>(variables)->vars;
+    auto it = vars.find(name);
+    auto f = it == vars.end() ? nullptr : dynamic_pointer_cast<ValueFunction>(it->second);
+    if (!f) throw runtime_error(name + " is not a script function");
+    return f;
+}
+
+valp Script::call(string name, vector<valp> args) {
+    StatsScope scope(account);
+    return callFunction(variables, findFunction(name), args);
+}
+
+Script::Batch Script::prepareBatch(string name, size_t argCount) {
+    return prepareBatch(findFunction(name), argCount);
+}
+
+Script::Batch Script::prepareBatch(shared_ptr<ValueFunction> f, size_t argCount) {
+    if (f->args.size() != argCount) throw runtime_error("Unmatching arguments");
+    Batch batch;
+    // `this` is the variables of the module defining f, as when called globally from there
+    if (f->module) batch.ctx = f->module->variables;
+    else batch.ctx = variables;
+    batch.f = f;
+    batch.env = valp(new ValueMap({}));
+    batch.none = valp(new ValueNone());
+    batch.args.resize(argCount);
+    return batch;
+}
+
+valp Script::callBatch(Batch& batch) {
+    StatsScope scope(account);
+    auto& f = *batch.f;
+    if (f.generator) return makeGenerator(batch.ctx, batch.f, batch.args);
+    valp result;
+    if (f.native && runNative(f, batch.args, result)) return result;
+    if (jitEnabled && runJit(f, batch.args, result)) return result;
+    // called again from the script while running
+    if (batch.running) return invoke(batch.ctx, batch.f, batch.args);
+    // variables of the next call start unassigned, the map nodes are kept
+    auto& vars = static_pointer_cast<ValueMap>(batch.env)->vars;
+    batch.running = true;
+    try {
+        result = invoke(batch.ctx, batch.f, batch.args, batch.env);
+    } catch (...) {
+        batch.running = false;
+        for (auto& e : vars) e.second = batch.none;
+        throw;
+    }
+    batch.running = false;
+    for (auto& e : vars) e.second = batch.none;
+    return result;
+}
+
+void Script::run(valp vars, statp s) {
+    if (engine == Engine::Closure) {
+        auto it = compiled.find(s.get());
+        if (it == compiled.end()) it = compiled.emplace(s.get(), Compiled{s, compile(s)}).first;
+        it->second.run(vars);
+    } else {
+        exec(vars, s);
+    }
+}
+
+InterpreterError Script::error(SourceInfo srcinfo, string str) {
+    account->stats.exceptions++;
+    if (tracing) traceEvent(TraceRecord::Error, TraceRecord::Script, str);
+    return InterpreterError(module ? module->source : source, srcinfo, str);
+}
+
+valp Script::makeFunction(vector<string> args, statp body, string name, NativeCode native) {
+    auto f = new ValueFunction(args, body);
+    f->name = name;
+    f->native = native;
+    f->script = this;
+    f->module = module;
+    f->generator = hasYield(body);
+    valp result(f);
+    auto& list = functions[body.get()];
+    // drop the functions freed since the list last grew, and grow it when
+    // most are alive so that at least half a list of pushes separates scans
+    if (list.size() == list.capacity()) {
+        list.erase(remove_if(list.begin(), list.end(), [](auto& w) { return w.expired(); }), list.end());
+        if (list.size() > list.capacity() / 2) list.reserve(list.capacity() * 2);
+    }
+    list.push_back(static_pointer_cast<ValueFunction>(result));
+    return result;
+}
+
+valp Script::import(string path) {
+    // Resolve path from the directory of the file being executed
+    string from = module ? module->filename : filename;
+    auto slash = from.find_last_of('/');
+    if (path[0] != '/' && slash != string::npos) path = from.substr(0, slash+1) + path;
+    return getModule(path);
+}
+
+// Path without `.` segments, `..` after a directory and repeated slashes, so
+// that a module imported through different paths is loaded once
+string normalPath(const string& path) {
+    bool absolute = !path.empty() && path[0] == '/';
+    vector<string> parts;
+    size_t i = 0;
+    while (i <= path.size()) {
+        size_t j = path.find('/', i);
+        if (j == string::npos) j = path.size();
+        string part = path.substr(i, j-i);
+        if (part == "..") {
+            if (!parts.empty() && parts.back() != "..") parts.pop_back();
+            else if (!absolute) parts.push_back(part);
+        } else if (!part.empty() && part != ".") {
+            parts.push_back(part);
+        }
+        i = j+1;
+    }
+    string r = absolute ? "/" : "";
+    for (size_t k=0;k<parts.size();k++) r += (k ? "/" : "") + parts[k];
+    return r;
+}
+
+valp Script::getModule(string path) {
+    path = normalPath(path);
+    auto it = modules.find(path);
+    if (it != modules.end()) return it->second->variables;
+
+    bool native = path.size() > 3 && path.compare(path.size()-3, 3, ".so") == 0;
+    if (!native && !compiledScripts().count(path) && !ifstream(path)) {
+        throw runtime_error("Can't find module " + path);
+    }
+    auto m = new Module();
+    m->filename = path;
+    // replaced by the text of script modules when they are loaded
+    m->source = make_shared<Source>(path, "");
+    modules[path] = unique_ptr<Module>(m);
+    // Modules are loaded when their variables are first accessed
+    m->variables = make_shared<ValueModule>([this, m, native](ValueMap& vars) {
+        if (native) {
+            // Shared objects stay loaded as long as the process since values may point to their code
+            void* lib = dlopen(m->filename.c_str(), RTLD_NOW | RTLD_LOCAL);
+            if (!lib) throw runtime_error(string("Can't load module: ") + dlerror());
+            auto entry = (ModuleEntry)dlsym(lib, ASCRIPT_MODULE_ENTRY);
+            if (!entry) throw runtime_error("Module " + m->filename + " has no " ASCRIPT_MODULE_ENTRY " function");
+            entry(vars);
+            return;
+        }
+        m->code = loadCode(m->filename, m->source);
+        Module* importer = module;
+        module = m;
+        try {
+            run(m->variables, m->code);
+        } catch (...) {
+            module = importer;
+            ret = nullptr;
+            throw;
+        }
+        module = importer;
+        ret = nullptr;
+    });
+    return m->variables;
+}
+
+void Script::setMaxCallDepth(size_t depth) {
+    maxCallDepth = depth;
+}
+
+void Script::setMaxStackSize(size_t size) {
+    maxStackSize = size;
+}
+
+void Script::setJit(bool enabled) {
+    jitEnabled = enabled;
+}
+
+void Script::setJitThreshold(size_t calls) {
+    jitThreshold = calls;
+}
+
+void Script::setEngine(Engine engine) {
+    this->engine = engine;
+}
+
+void Script::setTracing(bool enabled) {
+    tracing = enabled;
 }
 
 bool Script::isOver() {
     return false;
-}
\ No newline at end of file
+}
+
+Callback::Callback(valp fv, size_t argCount) {
+    if ((f = dynamic_pointer_cast<ValueFunction>(fv))) {
+        batch.reset(new Script::Batch(f->script->prepareBatch(f, argCount)));
+    } else if ((native = dynamic_pointer_cast<ValueNativeFunc>(fv))) {
+        args.resize(argCount);
+    } else throw runtime_error("Can't call non-function");
+}
+
+valp Callback::operator()(valp a) {
+    auto& v = batch ? batch->args : args;
+    v[0] = a;
+    return call();
+}
+
+valp Callback::operator()(valp a, valp b) {
+    auto& v = batch ? batch->args : args;
+    v[0] = a;
+    v[1] = b;
+    return call();
+}
+
+valp Callback::operator()(const vector<valp>& a) {
+    auto& v = batch ? batch->args : args;
+    copy(a.begin(), a.end(), v.begin());
+    return call();
+}
+
+valp Callback::call() {
+    if (batch) return f->script->callBatch(*batch);
+    if (auto a = StatsAccount::current) a->stats.nativeCalls++;
+    return native->f(args);
+}
@@ -0,0 +1,534 @@
+#include <ascript/script.h>
+#include <cstring>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+// see script.cpp
+statp loadCode(string path, shared_ptr<const Source>& source);
+
+/* Snapshot image layout (native endianness):
+   header: magic, source hash, value count, root value id, module count
+   uint64 offsets[count] of value records from the start of the image
+   modules: path and source hash of each loaded script module
+   records: uint8 tag followed by its payload, children are value ids */
+
+static const char magic[8] = {'A', 'S', 'S', 'N', 'A', 'P', 0, 2};
+// Id of a null value
+static const uint32_t nullId = -1;
+
+enum SnapshotTag : uint8_t {
+    TAG_NONE, TAG_INT, TAG_FLOAT, TAG_STR, TAG_LIST, TAG_MAP, TAG_RANGE, TAG_FUNCTION, TAG_MODULE, TAG_VEC, TAG_MAT,
+    TAG_SPARSE_LIST, TAG_MEMO
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint64_t hash;
+    uint32_t count;
+    uint32_t root;
+    uint32_t modules;
+};
+
+// FNV-1a, identifies the source a snapshot was taken from
+static uint64_t hashSource(const string& s) {
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static void visit(expp e, vector<FuncDefExp*>& funcs);
+
+// Lists function definitions of an AST in a stable order; index in the list identifies the function
+static void visit(statp sp, vector<FuncDefExp*>& funcs) {
+    if (!sp) return;
+    if (auto s = dynamic_pointer_cast<AssignStat>(sp)) {
+        visit(s->left, funcs);
+        visit(s->right, funcs);
+    }
+    else if (auto s = dynamic_pointer_cast<CompAssignStat>(sp)) {
+        visit(s->left, funcs);
+        visit(s->right, funcs);
+    }
+    else if (auto s = dynamic_pointer_cast<FuncCallStat>(sp)) {
+        visit(s->ctx, funcs);
+        for (auto a : s->a) visit(a, funcs);
+    }
+    else if (auto s = dynamic_pointer_cast<IfStat>(sp)) {
+        visit(s->cond, funcs);
+        visit(s->then, funcs);
+        visit(s->els, funcs);
+    }
+    else if (auto s = dynamic_pointer_cast<BlockStat>(sp)) {
+        for (auto ss : s->stats) visit(ss, funcs);
+    }
+    else if (auto s = dynamic_pointer_cast<WhileStat>(sp)) {
+        visit(s->cond, funcs);
+        visit(s->stat, funcs);
+    }
+    else if (auto s = dynamic_pointer_cast<ForStat>(sp)) {
+        visit(s->list, funcs);
+        visit(s->stat, funcs);
+    }
+    else if (auto s = dynamic_pointer_cast<ReturnStat>(sp)) {
+        visit(s->e, funcs);
+    }
+    else if (auto s = dynamic_pointer_cast<YieldStat>(sp)) {
+        visit(s->e, funcs);
+    }
+}
+
+static void visit(expp ep, vector<FuncDefExp*>& funcs) {
+    if (!ep) return;
+    if (auto e = dynamic_pointer_cast<BinOpExp>(ep)) {
+        visit(e->l, funcs);
+        visit(e->r, funcs);
+    }
+    else if (auto e = dynamic_pointer_cast<UnOpExp>(ep)) {
+        visit(e->l, funcs);
+    }
+    else if (auto e = dynamic_pointer_cast<MapDefExp>(ep)) {
+        for (auto f : e->values) visit(f.second, funcs);
+    }
+    else if (auto e = dynamic_pointer_cast<ListDefExp>(ep)) {
+        for (auto v : e->values) visit(v, funcs);
+    }
+    else if (auto e = dynamic_pointer_cast<RangeDefExp>(ep)) {
+        visit(e->beg, funcs);
+        visit(e->end, funcs);
+        visit(e->step, funcs);
+    }
+    else if (auto e = dynamic_pointer_cast<FuncCallExp>(ep)) {
+        visit(e->ctx, funcs);
+        for (auto a : e->a) visit(a, funcs);
+    }
+    else if (auto e = dynamic_pointer_cast<FuncDefExp>(ep)) {
+        funcs.push_back(e.get());
+        visit(e->body, funcs);
+    }
+    else if (auto e = dynamic_pointer_cast<IndexExp>(ep)) {
+        visit(e->l, funcs);
+        visit(e->i, funcs);
+    }
+    else if (auto e = dynamic_pointer_cast<MemberExp>(ep)) {
+        visit(e->l, funcs);
+    }
+    else if (auto e = dynamic_pointer_cast<TernaryExp>(ep)) {
+        visit(e->cond, funcs);
+        visit(e->then, funcs);
+        visit(e->els, funcs);
+    }
+    else if (auto e = dynamic_pointer_cast<AndExp>(ep)) {
+        visit(e->l, funcs);
+        visit(e->r, funcs);
+    }
+    else if (auto e = dynamic_pointer_cast<OrExp>(ep)) {
+        visit(e->l, funcs);
+        visit(e->r, funcs);
+    }
+}
+
+// Values belonging to the host, which links them again after restore
+static bool hostValue(const valp& v) {
+    // memoized script functions are saved with their function
+    if (auto m = dynamic_pointer_cast<ValueMemo>(v)) return hostValue(m->function);
+    return dynamic_pointer_cast<ValueNativeFunc>(v) || dynamic_pointer_cast<ValueExternBase>(v) ||
+        dynamic_pointer_cast<ValueChannel>(v);
+}
+
+// Whether the top level of a script module ran, so that its variables are saved
+static bool loaded(const Module& m) {
+    return m.code && !m.variables->error;
+}
+
+// Same as visit, for reload
+void listFunctions(statp code, vector<FuncDefExp*>& funcs) {
+    visit(code, funcs);
+}
+
+// Serializes values reachable from the script variables
+class SnapshotWriter {
+public:
+    SnapshotWriter(statp code, map<string, unique_ptr<Module>>& modules) : modules(modules) {
+        index(code, "");
+        for (auto& m : modules) {
+            if (loaded(*m.second)) index(m.second->code, m.first);
+        }
+    }
+
+    // Returns id of v, adding it to the image if needed
+    uint32_t add(valp v) {
+        if (!v) return nullId;
+        auto it = ids.find(v.get());
+        if (it != ids.end()) return it->second;
+        uint32_t id = records.size();
+        ids[v.get()] = id;
+        records.emplace_back();
+        string r = record(v);
+        records[id] = move(r);
+        return id;
+    }
+
+    void write(ostream& out, uint64_t hash, uint32_t root) {
+        SnapshotHeader h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, magic, 8);
+        h.hash = hash;
+        h.count = records.size();
+        h.root = root;
+        string table;
+        for (auto& m : modules) {
+            if (!loaded(*m.second)) continue;
+            putStr(table, m.first);
+            put<uint64_t>(table, hashSource(m.second->source->text));
+            h.modules++;
+        }
+        out.write((char*)&h, sizeof(h));
+        uint64_t offset = sizeof(h) + records.size()*sizeof(uint64_t) + table.size();
+        for (auto& r : records) {
+            out.write((char*)&offset, sizeof(offset));
+            offset += r.size();
+        }
+        out.write(table.data(), table.size());
+        for (auto& r : records) out.write(r.data(), r.size());
+    }
+
+private:
+    void index(statp code, string path) {
+        vector<FuncDefExp*> funcs;
+        visit(code, funcs);
+        for (uint32_t i=0;i<funcs.size();i++) bodies[funcs[i]->body.get()] = {path, i};
+    }
+
+    template <typename T>
+    static void put(string& r, T v) {
+        r.append((char*)&v, sizeof(T));
+    }
+    static void putStr(string& r, string_view s) {
+        put<uint32_t>(r, s.size());
+        r += s;
+    }
+
+    string record(valp v) {
+        string r;
+        if (auto x = dynamic_pointer_cast<ValueInt>(v)) {
+            put<uint8_t>(r, TAG_INT);
+            put<int32_t>(r, x->value);
+        }
+        else if (auto x = dynamic_pointer_cast<ValueFloat>(v)) {
+            put<uint8_t>(r, TAG_FLOAT);
+            put<float>(r, x->value);
+        }
+        else if (auto x = dynamic_pointer_cast<ValueStr>(v)) {
+            put<uint8_t>(r, TAG_STR);
+            putStr(r, x->view());
+        }
+        else if (auto x = dynamic_pointer_cast<ValueList>(v); x && x->isSparse()) {
+            // length, then index and id of stored elements
+            put<uint8_t>(r, TAG_SPARSE_LIST);
+            put<uint32_t>(r, x->size());
+            auto indices = x->indices();
+            put<uint32_t>(r, indices.size());
+            for (size_t i : indices) {
+                put<uint32_t>(r, i);
+                put<uint32_t>(r, add((*x)[i]));
+            }
+        }
+        else if (auto x = dynamic_pointer_cast<ValueList>(v)) {
+            put<uint8_t>(r, TAG_LIST);
+            put<uint32_t>(r, x->size());
+            for (size_t i=0;i<x->size();i++) put<uint32_t>(r, add((*x)[i]));
+        }
+        else if (auto x = dynamic_pointer_cast<ValueModule>(v)) {
+            for (auto& m : modules) {
+                if (m.second->variables != x) continue;
+                // path, then variables like a map for script modules which ran
+                put<uint8_t>(r, TAG_MODULE);
+                putStr(r, m.first);
+                put<uint8_t>(r, loaded(*m.second));
+                if (!loaded(*m.second)) return r;
+                vector<pair<string, valp>> vars;
+                for (auto& e : x->vars) {
+                    if (!hostValue(e.second)) vars.push_back(e);
+                }
+                put<uint32_t>(r, vars.size());
+                for (auto& e : vars) {
+                    putStr(r, e.first);
+                    put<uint32_t>(r, add(e.second));
+                }
+                return r;
+            }
+            throw runtime_error("Can't snapshot unknown module");
+        }
+        else if (auto x = dynamic_pointer_cast<ValueMap>(v)) {
+            put<uint8_t>(r, TAG_MAP);
+            put<uint32_t>(r, x->vars.size());
+            for (auto& e : x->vars) {
+                putStr(r, e.first);
+                put<uint32_t>(r, add(e.second));
+            }
+        }
+        else if (auto x = dynamic_pointer_cast<ValueRange>(v)) {
+            put<uint8_t>(r, TAG_RANGE);
+            put<int32_t>(r, x->beg);
+            put<int32_t>(r, x->end);
+            put<int32_t>(r, x->step);
+        }
+        else if (auto x = dynamic_pointer_cast<ValueFunction>(v)) {
+            auto it = bodies.find(x->body.get());
+            if (it == bodies.end()) throw runtime_error("Can't snapshot function of unloaded module");
+            put<uint8_t>(r, TAG_FUNCTION);
+            putStr(r, it->second.first);
+            put<uint32_t>(r, it->second.second);
+        }
+        else if (auto x = dynamic_pointer_cast<ValueMemo>(v)) {
+            // wrapped function and capacity, results are cached again after restore
+            put<uint8_t>(r, TAG_MEMO);
+            put<uint32_t>(r, add(x->function));
+            put<uint32_t>(r, x->capacity);
+        }
+        else if (auto x = dynamic_pointer_cast<ValueVec>(v)) {
+            put<uint8_t>(r, TAG_VEC);
+            put<uint8_t>(r, x->n);
+            for (int i=0;i<x->n;i++) put<float>(r, x->v[i]);
+        }
+        else if (auto x = dynamic_pointer_cast<ValueMat>(v)) {
+            put<uint8_t>(r, TAG_MAT);
+            for (int i=0;i<16;i++) put<float>(r, x->m[i]);
+        }
+        else if (dynamic_pointer_cast<ValueNone>(v)) {
+            put<uint8_t>(r, TAG_NONE);
+        }
+        else throw runtime_error("Can't snapshot value " + v->print());
+        return r;
+    }
+
+    map<string, unique_ptr<Module>>& modules;
+    // Function bodies -> module path and function id
+    map<Stat*, pair<string, uint32_t>> bodies;
+    map<Value*, uint32_t> ids;
+    vector<string> records;
+};
+
+void Script::snapshot(string path) {
+    SnapshotWriter w(code, modules);
+    // Native functions, linked variables and channels belong to the host, which links them again
+    auto root = new ValueMap({});
+    valp rootp(root);
+    for (auto& v : dynamic_pointer_cast<ValueMap>(variables)->vars) {
+        if (!hostValue(v.second)) root->vars[v.first] = v.second;
+    }
+    uint32_t rootId = w.add(rootp);
+    // modules which ran are restored without running them again, even when no variable refers to them
+    for (auto& m : modules) {
+        if (loaded(*m.second)) w.add(m.second->variables);
+    }
+    ofstream out(path, ios::binary);
+    if (!out) throw runtime_error("Can't write snapshot " + path);
+    w.write(out, hashSource(source->text), rootId);
+}
+
+// Reads an image mapped in memory
+class SnapshotReader {
+public:
+    SnapshotReader(const char* data, size_t size) : data(data), size(size) {}
+
+    template <typename T>
+    T get(size_t& pos) {
+        if (pos + sizeof(T) > size) throw runtime_error("Corrupted snapshot");
+        T v;
+        memcpy(&v, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return v;
+    }
+    string getStr(size_t& pos) {
+        uint32_t len = get<uint32_t>(pos);
+        if (pos + len > size) throw runtime_error("Corrupted snapshot");
+        pos += len;
+        return string(data + pos - len, len);
+    }
+    size_t offset(uint32_t id) {
+        size_t pos = sizeof(SnapshotHeader) + id*sizeof(uint64_t);
+        return get<uint64_t>(pos);
+    }
+
+    const char* data;
+    size_t size;
+};
+
+void Script::restore(string path) {
+    StatsScope scope(account);
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw runtime_error("Can't open snapshot " + path);
+    struct stat st;
+    fstat(fd, &st);
+    size_t size = st.st_size;
+    void* mem = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mem == MAP_FAILED) throw runtime_error("Can't map snapshot " + path);
+    shared_ptr<void> unmap(mem, [size](void* m) { munmap(m, size); });
+
+    SnapshotReader r((const char*)mem, size);
+    size_t pos = 0;
+    auto h = r.get<SnapshotHeader>(pos);
+    if (memcmp(h.magic, magic, 8) != 0) throw runtime_error("Not a snapshot: " + path);
+    if (h.hash != hashSource(source->text)) throw runtime_error("Snapshot was taken from another version of " + filename);
+
+    // Functions ids, by module path
+    map<string, vector<FuncDefExp*>> funcs;
+    visit(code, funcs[""]);
+
+    // Check the source of every module before changing any of them
+    struct Loaded { string path; shared_ptr<const Source> source; statp code; };
+    vector<Loaded> loadedModules;
+    pos = sizeof(SnapshotHeader) + (size_t)h.count*sizeof(uint64_t);
+    for (uint32_t i=0;i<h.modules;i++) {
+        Loaded l;
+        l.path = r.getStr(pos);
+        uint64_t hash = r.get<uint64_t>(pos);
+        auto it = modules.find(l.path);
+        if (it != modules.end() && it->second->code) {
+            l.source = it->second->source;
+            l.code = it->second->code;
+        } else {
+            l.code = loadCode(l.path, l.source);
+        }
+        if (hash != hashSource(l.source->text)) throw runtime_error("Snapshot was taken from another version of " + l.path);
+        loadedModules.push_back(move(l));
+    }
+    // Their variables come from the snapshot instead of running their code
+    for (auto& l : loadedModules) {
+        getModule(l.path);
+        auto& m = modules[l.path];
+        m->source = l.source;
+        m->code = l.code;
+        m->variables->loader = nullptr;
+        m->variables->error = nullptr;
+        visit(m->code, funcs[l.path]);
+    }
+
+    // Create values first, then fill containers so that references can form cycles
+    vector<valp> values(h.count);
+    for (uint32_t id=0;id<h.count;id++) {
+        pos = r.offset(id);
+        auto tag = r.get<uint8_t>(pos);
+        switch (tag) {
+        case TAG_NONE: values[id] = valp(new ValueNone()); break;
+        case TAG_INT: values[id] = valp(new ValueInt(r.get<int32_t>(pos))); break;
+        case TAG_FLOAT: values[id] = valp(new ValueFloat(r.get<float>(pos))); break;
+        case TAG_STR: values[id] = valp(new ValueStr(r.getStr(pos))); break;
+        case TAG_LIST: case TAG_SPARSE_LIST: values[id] = valp(new ValueList({})); break;
+        case TAG_MAP: values[id] = valp(new ValueMap({})); break;
+        case TAG_RANGE: {
+            int beg = r.get<int32_t>(pos);
+            int end = r.get<int32_t>(pos);
+            int step = r.get<int32_t>(pos);
+            values[id] = valp(new ValueRange(beg, end, step));
+            break;
+        }
+        case TAG_VEC: {
+            auto v = new ValueVec(r.get<uint8_t>(pos));
+            values[id] = valp(v);
+            for (int i=0;i<v->n;i++) v->v[i] = r.get<float>(pos);
+            break;
+        }
+        case TAG_MAT: {
+            auto m = new ValueMat();
+            values[id] = valp(m);
+            for (int i=0;i<16;i++) m->m[i] = r.get<float>(pos);
+            break;
+        }
+        case TAG_MODULE: {
+            string mpath = r.getStr(pos);
+            if (r.get<uint8_t>(pos) && !funcs.count(mpath)) throw runtime_error("Corrupted snapshot");
+            values[id] = getModule(mpath);
+            break;
+        }
+        case TAG_FUNCTION: {
+            string mpath = r.getStr(pos);
+            uint32_t fid = r.get<uint32_t>(pos);
+            auto it = funcs.find(mpath);
+            if (it == funcs.end()) throw runtime_error("Corrupted snapshot");
+            Module* m = mpath.empty() ? nullptr : modules[mpath].get();
+            auto& fs = it->second;
+            if (fid >= fs.size()) throw runtime_error("Corrupted snapshot");
+            Module* current = module;
+            module = m;
+            values[id] = makeFunction(fs[fid]->args, fs[fid]->body, fs[fid]->name, fs[fid]->native);
+            module = current;
+            break;
+        }
+        // created once the functions they wrap exist
+        case TAG_MEMO: break;
+        default: throw runtime_error("Corrupted snapshot");
+        }
+    }
+    // Memos wrap functions or other memos, created first
+    function<valp(uint32_t, uint32_t)> memo = [&](uint32_t id, uint32_t depth) {
+        if (values[id]) return values[id];
+        pos = r.offset(id);
+        if (depth > h.count || r.get<uint8_t>(pos) != TAG_MEMO) throw runtime_error("Corrupted snapshot");
+        uint32_t fid = r.get<uint32_t>(pos);
+        uint32_t capacity = r.get<uint32_t>(pos);
+        if (fid >= h.count || capacity == 0) throw runtime_error("Corrupted snapshot");
+        valp f = memo(fid, depth+1);
+        values[id] = valp(new ValueMemo(f, capacity));
+        return values[id];
+    };
+    for (uint32_t id=0;id<h.count;id++) memo(id, 0);
+    auto child = [&](uint32_t id) -> valp {
+        if (id == nullId) return nullptr;
+        if (id >= h.count) throw runtime_error("Corrupted snapshot");
+        return values[id];
+    };
+    for (uint32_t id=0;id<h.count;id++) {
+        pos = r.offset(id);
+        auto tag = r.get<uint8_t>(pos);
+        if (tag == TAG_LIST) {
+            auto l = dynamic_pointer_cast<ValueList>(values[id]);
+            uint32_t n = r.get<uint32_t>(pos);
+            auto& elements = l->values();
+            elements.reserve(n);
+            for (uint32_t i=0;i<n;i++) elements.push_back(child(r.get<uint32_t>(pos)));
+        } else if (tag == TAG_SPARSE_LIST) {
+            auto l = dynamic_pointer_cast<ValueList>(values[id]);
+            uint32_t length = r.get<uint32_t>(pos);
+            uint32_t n = r.get<uint32_t>(pos);
+            vector<pair<uint32_t, uint32_t>> elements(n);
+            for (auto& e : elements) {
+                e.first = r.get<uint32_t>(pos);
+                e.second = r.get<uint32_t>(pos);
+                if (e.first >= length) throw runtime_error("Corrupted snapshot");
+            }
+            l->resizeSparse(length);
+            for (auto& e : elements) l->atRef(e.first) = child(e.second);
+        } else if (tag == TAG_MAP || tag == TAG_MODULE) {
+            if (tag == TAG_MODULE) {
+                r.getStr(pos);
+                if (!r.get<uint8_t>(pos)) continue;
+            }
+            auto m = dynamic_pointer_cast<ValueMap>(values[id]);
+            uint32_t n = r.get<uint32_t>(pos);
+            for (uint32_t i=0;i<n;i++) {
+                string key = r.getStr(pos);
+                m->vars[key] = child(r.get<uint32_t>(pos));
+            }
+        }
+    }
+
+    auto root = dynamic_pointer_cast<ValueMap>(child(h.root));
+    if (!root) throw runtime_error("Corrupted snapshot");
+    for (auto& v : root->vars) {
+        // keep what the host linked
+        auto& cur = variables->getRef(v.first);
+        if (hostValue(cur)) continue;
+        cur = v.second;
+    }
+}
@@ -0,0 +1,69 @@
+#include <ascript/script.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+// A call nested deeper than the native stack allows runs on a stack mapped by
+// the script while its caller waits on its own stack, so deep recursion is
+// bounded by the call depth limit and memory rather than by the host thread
+// stack. The interpreter itself doesn't change, like for generators.
+
+// Room kept below the limit for the statements and native functions run
+// between two calls
+static const size_t MARGIN = 1 << 20;
+// Stacks kept for reuse
+static const size_t MAX_FREE_STACKS = 4;
+
+valp Script::invokeOnNewStack(valp ctx, shared_ptr<ValueFunction> f, vector<valp> args, valp env) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    Stack stack;
+    if (!freeStacks.empty()) {
+        stack = freeStacks.back();
+        freeStacks.pop_back();
+    } else {
+        stack.size = (maxStackSize + MARGIN + page - 1) / page * page + page;
+        stack.base = mmap(nullptr, stack.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (stack.base == MAP_FAILED) throw runtime_error("Can't allocate call stack");
+        // guard page
+        mprotect(stack.base, page, PROT_NONE);
+    }
+
+    struct Call {
+        Script* script;
+        valp ctx;
+        shared_ptr<ValueFunction> f;
+        vector<valp> args;
+        valp env;
+        valp result;
+        exception_ptr error;
+        ucontext_t context, callerContext;
+    } call{this, ctx, f, move(args), env};
+    auto entry = +[](unsigned hi, unsigned lo) {
+        auto c = (Call*)(((uintptr_t)hi << 32) | lo);
+        try {
+            c->result = c->script->invoke(c->ctx, c->f, move(c->args), c->env);
+        } catch (...) {
+            c->error = current_exception();
+        }
+        // returns to callerContext through uc_link
+    };
+    getcontext(&call.context);
+    call.context.uc_stack.ss_sp = stack.base;
+    call.context.uc_stack.ss_size = stack.size;
+    call.context.uc_link = &call.callerContext;
+    // makecontext only passes ints
+    uintptr_t p = (uintptr_t)&call;
+    makecontext(&call.context, (void (*)())entry, 2, (unsigned)(p >> 32), (unsigned)p);
+
+    uintptr_t limit = stackLimit;
+    stackLimit = (uintptr_t)stack.base + page + MARGIN;
+    swapcontext(&call.callerContext, &call.context);
+    stackLimit = limit;
+
+    if (freeStacks.size() < MAX_FREE_STACKS) freeStacks.push_back(stack);
+    else munmap(stack.base, stack.size);
+    if (call.error) rethrow_exception(call.error);
+    return call.result;
+}
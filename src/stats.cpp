@@ -0,0 +1,53 @@
+#include <ascript/script.h>
+#include <sstream>
+#include <algorithm>
+
+using namespace std;
+
+[[noreturn]] static void overLimit(int64_t limit) {
+    throw runtime_error("Out of memory, the script heap is limited to " + to_string(limit) + " bytes");
+}
+
+void StatsAccount::chargePeak(int64_t heap) {
+    if (heap > hardLimit) overLimit(hardLimit);
+    if (heap > stats.peakHeapBytes) stats.peakHeapBytes = heap;
+    bool soft = heap > softLimit && !softLimitReached;
+    if (soft) softLimitReached = true;
+    updateWatermark();
+    if (soft && onSoftLimit) onSoftLimit(heap);
+}
+
+void StatsAccount::updateWatermark() {
+    watermark = min(stats.peakHeapBytes, hardLimit);
+    if (!softLimitReached) watermark = min(watermark, softLimit);
+}
+
+void checkHeap(size_t size) {
+    // past the size of any object
+    if (size >= (size_t)PTRDIFF_MAX) throw runtime_error("Out of memory");
+    auto a = StatsAccount::current;
+    if (a && (int64_t)size > a->hardLimit - a->heapBytes()) overLimit(a->hardLimit);
+}
+
+void heapExhausted(StatsAccount* account, size_t size) {
+    if (account) heapCredit(account, size);
+    throw runtime_error("Out of memory");
+}
+
+string ScriptStats::dump() const {
+    static const char* kinds[] = {"int", "float", "str", "list", "map", "function", "vec", "other"};
+    stringstream ss;
+    ss << "ascript_statements_total " << statements << "\n";
+    ss << "ascript_calls_total{kind=\"script\"} " << scriptCalls << "\n";
+    ss << "ascript_calls_total{kind=\"native\"} " << nativeCalls << "\n";
+    for (int k=0;k<ValueKinds;k++) {
+        ss << "ascript_values_total{kind=\"" << kinds[k] << "\"} " << values[k] << "\n";
+    }
+    ss << "ascript_heap_bytes " << heapBytes << "\n";
+    ss << "ascript_heap_peak_bytes " << peakHeapBytes << "\n";
+    ss << "ascript_map_lookups_total " << mapLookups << "\n";
+    ss << "ascript_exceptions_total " << exceptions << "\n";
+    ss << "ascript_memo_calls_total{result=\"hit\"} " << memoHits << "\n";
+    ss << "ascript_memo_calls_total{result=\"miss\"} " << memoMisses << "\n";
+    return ss.str();
+}
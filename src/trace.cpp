@@ -0,0 +1,140 @@
+#include <ascript/trace.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+static_assert(sizeof(TraceRecord) == 64, "Trace records should fill a cache line");
+
+// Records of one thread, written by that thread only
+// Exports copy records while they may be written and drop those that were
+// overwritten meanwhile.
+struct TraceBuffer {
+    TraceBuffer(uint32_t thread) : records(TRACE_BUFFER_SIZE), thread(thread) {}
+    vector<TraceRecord> records;
+    // Number of records written since the buffer was created
+    atomic<uint64_t> head{0};
+    // Records before this one were cleared
+    atomic<uint64_t> start{0};
+    uint32_t thread;
+};
+
+// Buffers of all threads that recorded events, kept after threads end
+static mutex buffersMutex;
+static vector<shared_ptr<TraceBuffer>> buffers;
+
+// Clock at the first event, to convert ticks to time
+static once_flag calibrated;
+static uint64_t startTicks;
+static chrono::steady_clock::time_point startTime;
+
+uint64_t traceClock() {
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static TraceBuffer& threadBuffer() {
+    thread_local shared_ptr<TraceBuffer> buffer;
+    if (!buffer) {
+        call_once(calibrated, [] {
+            startTicks = traceClock();
+            startTime = chrono::steady_clock::now();
+        });
+        lock_guard<mutex> lock(buffersMutex);
+        buffer = make_shared<TraceBuffer>(buffers.size());
+        buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+void traceEvent(TraceRecord::Event event, TraceRecord::Category category, const string& name) {
+    auto& b = threadBuffer();
+    uint64_t i = b.head.load(memory_order_relaxed);
+    auto& r = b.records[i % TRACE_BUFFER_SIZE];
+    r.time = traceClock();
+    r.event = event;
+    r.category = category;
+    r.length = min(name.size(), sizeof(r.name));
+    memcpy(r.name, name.data(), r.length);
+    b.head.store(i+1, memory_order_release);
+}
+
+// Writes s as a JSON string
+static void writeJson(ostream& out, const char* s, size_t n) {
+    out << '"';
+    for (size_t i=0;i<n;i++) {
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\') out << '\\' << c;
+        else if (c < 32) {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out << esc;
+        }
+        else out << c;
+    }
+    out << '"';
+}
+
+void writeChromeTrace(ostream& out) {
+    vector<shared_ptr<TraceBuffer>> bs;
+    {
+        lock_guard<mutex> lock(buffersMutex);
+        bs = buffers;
+    }
+    // ticks per microsecond since the first event
+    double ticksPerUs = 1;
+    if (!bs.empty()) {
+        double us = chrono::duration<double, micro>(chrono::steady_clock::now() - startTime).count();
+        if (us > 0) ticksPerUs = (traceClock() - startTicks) / us;
+    }
+    static const char* categories[] = {"script", "native"};
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (auto& b : bs) {
+        uint64_t end = b->head.load(memory_order_acquire);
+        uint64_t beg = max(b->start.load(), end > TRACE_BUFFER_SIZE ? end - TRACE_BUFFER_SIZE : 0);
+        vector<TraceRecord> rs;
+        for (uint64_t i=beg;i<end;i++) rs.push_back(b->records[i % TRACE_BUFFER_SIZE]);
+        // records that were written again while copying are dropped, and the
+        // one at head which the thread may be writing
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t now = b->head.load(memory_order_relaxed) + 1;
+        size_t skip = now > TRACE_BUFFER_SIZE + beg ? now - TRACE_BUFFER_SIZE - beg : 0;
+        for (size_t i=skip;i<rs.size();i++) {
+            auto& r = rs[i];
+            if (!first) out << ",";
+            first = false;
+            out << "\n{\"name\":";
+            if (r.event == TraceRecord::Error) out << "\"error\"";
+            else if (r.length == 0) out << "\"(anonymous)\"";
+            else writeJson(out, r.name, r.length);
+            out << ",\"cat\":\"" << categories[r.category] << "\"";
+            if (r.event == TraceRecord::Enter) out << ",\"ph\":\"B\"";
+            else if (r.event == TraceRecord::Exit) out << ",\"ph\":\"E\"";
+            else {
+                out << ",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"message\":";
+                writeJson(out, r.name, r.length);
+                out << "}";
+            }
+            out << ",\"ts\":" << (int64_t)(r.time - startTicks) / ticksPerUs;
+            out << ",\"pid\":1,\"tid\":" << b->thread << "}";
+        }
+    }
+    out << "\n]}\n";
+}
+
+void clearTrace() {
+    lock_guard<mutex> lock(buffersMutex);
+    for (auto& b : buffers) b->start = b->head.load();
+}
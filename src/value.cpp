@@ -1,9 +1,18 @@
 #include <ascript/script.h>
 #include <vector>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <deque>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
 valp Value::unop(string op) {
+    if (op == "not") return valp(new ValueInt(!isTrue()));
     throw runtime_error("Unsupported Unop");
 }
 valp Value::binop(string op, valp r) {
@@ -18,6 +27,24 @@ valp Value::at(int id) {
 valp& Value::atRef(int id) {
     throw runtime_error("Not iterable");
 }
+// Iterates with length/at, length is checked at each step since the value may grow
+struct IndexIterator : public Iterator {
+    IndexIterator(Value* v) : v(v) {}
+    virtual valp next() {
+        if (i >= v->length()) return nullptr;
+        auto e = v->at(i++);
+        // unassigned list elements
+        if (!e) e = valp(new ValueNone());
+        return e;
+    }
+    Value* v;
+    size_t i = 0;
+};
+iterp Value::iter() {
+    // fail before the first step when not iterable
+    length();
+    return iterp(new IndexIterator(this));
+}
 valp Value::get(string mem) {
     throw runtime_error("Can't get member from non-map");
 }
@@ -25,7 +52,7 @@ valp& Value::getRef(string mem) {
     throw runtime_error("Can't get member from non-map");
 }
 bool Value::isTrue() {
-    throw runtime_error("Can't evaluate to boolean");
+    return true;
 }
 int Value::getInt() {
     throw runtime_error("Not an int");
@@ -37,26 +64,318 @@ string Value::getStr() {
     throw runtime_error("Not a string");
 }
 valp ValueMap::get(std::string mem) { 
-    return vars[mem];
+    if (auto a = StatsAccount::current) a->stats.mapLookups++;
+    auto it = vars.find(mem);
+    if (it == vars.end() || !it->second) return valp(new ValueNone());
+    return it->second;
 }
 valp &ValueMap::getRef(std::string mem) { 
+    if (auto a = StatsAccount::current) a->stats.mapLookups++;
     auto it = vars.find(mem);
-    if (it == vars.end()) vars[mem] = valp(new ValueNone());
-    return vars[mem];
+    if (it == vars.end()) it = vars.emplace(mem, valp(new ValueNone())).first;
+    return it->second;
+}
+struct MapIterator : public Iterator {
+    MapIterator(var& vars) : vars(vars), it(vars.begin()) {}
+    virtual valp next() {
+        if (it == vars.end()) return nullptr;
+        return valp(new ValueStr((it++)->first));
+    }
+    var& vars;
+    var::iterator it;
+};
+iterp ValueMap::iter() {
+    return iterp(new MapIterator(vars));
+}
+void ValueModule::load() {
+    if (error) rethrow_exception(error);
+    if (!loader) return;
+    // reset loader first so that cyclic imports see the partially loaded module
+    auto l = loader;
+    loader = nullptr;
+    try {
+        l(*this);
+    } catch (...) {
+        // later accesses raise the same error rather than see the module half loaded
+        error = current_exception();
+        throw;
+    }
+}
+valp ValueModule::get(std::string mem) {
+    load();
+    return ValueMap::get(mem);
 }
+valp &ValueModule::getRef(std::string mem) {
+    load();
+    return ValueMap::getRef(mem);
+}
+iterp ValueModule::iter() {
+    load();
+    return ValueMap::iter();
+}
+bool ValueModule::isTrue() {
+    load();
+    return ValueMap::isTrue();
+}
+// Elements of a list, counted in the script heap with their control block
+static shared_ptr<vallist> newStorage(size_t n = 0) {
+    return allocate_shared<vallist>(HeapAllocator<vallist>(), n);
+}
+// Lists are made sparse by assignments past this index that leave them less than a quarter full
+static const size_t SPARSE_MIN = 64;
+
 size_t ValueList::length() {
-    return values.size();
+    return size();
 }
 valp ValueList::at(int i) {
-    return values.at(i);
+    if (i < 0 || i >= size()) throw runtime_error("Index out of range");
+    auto& v = (*this)[i];
+    return v ? v : valp(new ValueNone());
 }
 valp& ValueList::atRef(int i) {
-    if (i >= length()) values.resize(i+1);
-    return values.at(i);
+    if (i < 0) throw runtime_error("Index out of range");
+    size_t n = i;
+    // elements are only counted when the list can't be a quarter full
+    if (!sparse && n >= SPARSE_MIN && n + 1 > 4 * (size() + 1) && (stored() + 1) * 4 < n + 1) makeSparse();
+    if (sparse) {
+        auto& s = *sparse;
+        if (n >= s.length) s.length = n+1;
+        auto& v = s.elements[n];
+        if (s.elements.size() * 2 < s.length) return v;
+        makeDense();
+    }
+    auto& v = values();
+    if (n >= v.size()) v.resize(n+1);
+    return v[n];
+}
+vallist& ValueList::values() {
+    if (sparse) makeDense();
+    if (view || storage.use_count() > 1) {
+        // copy elements shared with other lists
+        auto s = newStorage();
+        s->reserve(size());
+        for (size_t i=0;i<size();i++) s->push_back((*this)[i]);
+        storage = s;
+        view = false;
+    }
+    return *storage;
+}
+void ValueList::resize(size_t n) {
+    if (!sparse) {
+        values().resize(n);
+        return;
+    }
+    auto& s = *sparse;
+    if (n < s.length) {
+        if (s.length - n < s.elements.size()) {
+            for (size_t i=n;i<s.length;i++) s.elements.erase(i);
+        } else {
+            for (auto it = s.elements.begin(); it != s.elements.end();) {
+                if (it->first >= n) it = s.elements.erase(it);
+                else ++it;
+            }
+        }
+    }
+    s.length = n;
+    if (s.elements.size() * 2 >= s.length) makeDense();
+}
+void ValueList::resizeSparse(size_t n) {
+    if (!sparse) makeSparse();
+    resize(n);
+}
+vector<size_t> ValueList::indices() const {
+    vector<size_t> r;
+    if (sparse) {
+        r.reserve(sparse->elements.size());
+        for (auto& e : sparse->elements) {
+            if (e.second) r.push_back(e.first);
+        }
+        sort(r.begin(), r.end());
+    } else {
+        for (size_t i=0;i<size();i++) {
+            if ((*this)[i]) r.push_back(i);
+        }
+    }
+    return r;
+}
+size_t ValueList::stored() const {
+    if (sparse) return sparse->elements.size();
+    size_t n = 0;
+    for (size_t i=0;i<size();i++) n += (bool)(*this)[i];
+    return n;
+}
+void ValueList::makeSparse() {
+    auto s = make_unique<Sparse>();
+    s->length = size();
+    for (size_t i=0;i<size();i++) {
+        if (auto& v = (*this)[i]) s->elements.emplace(i, v);
+    }
+    storage = newStorage();
+    view = false;
+    sparse = move(s);
+}
+void ValueList::makeDense() {
+    auto v = newStorage(sparse->length);
+    for (auto& e : sparse->elements) (*v)[e.first] = move(e.second);
+    sparse.reset();
+    storage = v;
+}
+valp ValueList::slice(size_t beg, size_t count, size_t step) {
+    auto l = new ValueList({});
+    valp result(l);
+    if (sparse) {
+        l->sparse = make_unique<Sparse>();
+        l->sparse->length = count;
+        for (auto& e : sparse->elements) {
+            size_t i = e.first;
+            if (i >= beg && (i - beg) % step == 0 && (i - beg) / step < count) {
+                l->sparse->elements.emplace((i - beg) / step, e.second);
+            }
+        }
+        if (l->sparse->elements.size() * 2 >= count) l->makeDense();
+        return result;
+    }
+    l->storage = storage;
+    l->view = true;
+    l->offset = view ? offset + beg*stride : beg;
+    l->stride = view ? stride*step : step;
+    l->count = count;
+    return result;
+}
+// Whether a == b, values without == are only equal to themselves
+static bool equals(const valp& a, const valp& b) {
+    if (a == b) return true;
+    try {
+        return a->binop("==", b)->isTrue();
+    } catch (runtime_error&) {
+        return false;
+    }
+}
+
+static void checkArgs(vector<valp>& args, size_t n) {
+    if (args.size() != n) throw runtime_error("Unmatched argument number");
+}
+
+// Element i, None for holes
+static valp element(const ValueList& l, size_t i) {
+    auto& v = l[i];
+    return v ? v : valp(new ValueNone());
 }
+
+// List methods, by name
+static const map<string, valp (*)(ValueList&, vector<valp>&)> listMethods = {
+    {"length", [](ValueList& l, vector<valp>& a) {
+        checkArgs(a, 0);
+        return valp(new ValueInt(l.size()));
+    }},
+    {"push", [](ValueList& l, vector<valp>& a) {
+        checkArgs(a, 1);
+        l.atRef(l.size()) = a[0];
+        return valp(new ValueNone());
+    }},
+    {"pop", [](ValueList& l, vector<valp>& a) {
+        checkArgs(a, 0);
+        if (l.size() == 0) throw runtime_error("Can't pop from empty list");
+        auto v = element(l, l.size() - 1);
+        l.resize(l.size() - 1);
+        return v;
+    }},
+    {"indices", [](ValueList& l, vector<valp>& a) {
+        checkArgs(a, 0);
+        auto r = new ValueList({});
+        valp rp(r);
+        auto& values = r->values();
+        for (size_t i : l.indices()) values.push_back(valp(new ValueInt(i)));
+        return rp;
+    }},
+    {"slice", [](ValueList& l, vector<valp>& a) {
+        if (a.size() != 2 && a.size() != 3) throw runtime_error("Unmatched argument number");
+        int beg = a[0]->getInt(), end = a[1]->getInt();
+        int step = a.size() == 3 ? a[2]->getInt() : 1;
+        if (beg < 0 || end > (int)l.size() || beg > end) throw runtime_error("Slice out of range");
+        if (step <= 0) throw runtime_error("Slice step must be positive");
+        return l.slice(beg, (end - beg + step - 1) / step, step);
+    }},
+    {"find", [](ValueList& l, vector<valp>& a) {
+        checkArgs(a, 1);
+        if (dynamic_pointer_cast<ValueFunction>(a[0]) || dynamic_pointer_cast<ValueNativeFunc>(a[0])) {
+            Callback pred(a[0], 1);
+            for (size_t i=0;i<l.size();i++) {
+                if (pred(element(l, i))->isTrue()) return valp(new ValueInt(i));
+            }
+        } else {
+            for (size_t i=0;i<l.size();i++) {
+                if (l[i] && equals(l[i], a[0])) return valp(new ValueInt(i));
+            }
+        }
+        return valp(new ValueInt(-1));
+    }},
+    {"map", [](ValueList& l, vector<valp>& a) {
+        checkArgs(a, 1);
+        Callback f(a[0], 1);
+        auto r = new ValueList({});
+        valp rp(r);
+        auto& values = r->values();
+        values.resize(l.size());
+        // the callback may change the list
+        for (size_t i=0;i<l.size() && i<values.size();i++) values[i] = f(element(l, i));
+        return rp;
+    }},
+    {"filter", [](ValueList& l, vector<valp>& a) {
+        checkArgs(a, 1);
+        Callback f(a[0], 1);
+        auto r = new ValueList({});
+        valp rp(r);
+        auto& values = r->values();
+        values.reserve(l.size());
+        for (size_t i=0;i<l.size();i++) {
+            auto v = element(l, i);
+            if (f(v)->isTrue()) values.push_back(v);
+        }
+        return rp;
+    }},
+    {"reduce", [](ValueList& l, vector<valp>& a) {
+        checkArgs(a, 2);
+        Callback f(a[0], 2);
+        valp acc = a[1];
+        for (size_t i=0;i<l.size();i++) acc = f(acc, element(l, i));
+        return acc;
+    }},
+    {"sort", [](ValueList& l, vector<valp>& a) {
+        if (a.size() > 1) throw runtime_error("Unmatched argument number");
+        // sort a copy so that the list stays whole if a comparison fails
+        vallist values;
+        values.reserve(l.size());
+        for (size_t i=0;i<l.size();i++) values.push_back(element(l, i));
+        if (a.size() == 1) {
+            Callback less(a[0], 2);
+            stable_sort(values.begin(), values.end(), [&](const valp& x, const valp& y) {
+                return less(x, y)->isTrue();
+            });
+        } else if (all_of(values.begin(), values.end(), [](const valp& v) { return dynamic_cast<ValueInt*>(v.get()); })) {
+            stable_sort(values.begin(), values.end(), [](const valp& x, const valp& y) {
+                return static_cast<ValueInt*>(x.get())->value < static_cast<ValueInt*>(y.get())->value;
+            });
+        } else {
+            stable_sort(values.begin(), values.end(), [](const valp& x, const valp& y) {
+                return x->binop("<", y)->isTrue();
+            });
+        }
+        l.values().swap(values);
+        return valp(new ValueNone());
+    }},
+    {"reverse", [](ValueList& l, vector<valp>& a) {
+        checkArgs(a, 0);
+        auto& values = l.values();
+        reverse(values.begin(), values.end());
+        return valp(new ValueNone());
+    }},
+};
+
 valp ValueList::call(std::string f, std::vector<valp> args) {
-    if (f == "length" && args.size() == 0) return valp(new ValueInt(length()));
-    throw std::runtime_error("Unknown method");
+    auto it = listMethods.find(f);
+    if (it == listMethods.end()) throw std::runtime_error("Unknown method");
+    return it->second(*this, args);
 }
 size_t ValueRange::length() {
     return ((end-beg)/step)+1;
@@ -96,8 +415,6 @@ template <typename T> T binop0(T l, T r, string op) {
     if (op == ">=") return l>=r;
     if (op == "<") return l<r;
     if (op == ">") return l>r;
-    if (op == "and") return l&&r;
-    if (op == "or" ) return l||r;
     throw runtime_error("unknown op");
 }
 
@@ -106,6 +423,9 @@ valp ValueInt::binop(string op, valp rp) {
         return valp(new ValueInt(binop0(value, r->value, op)));
     if (auto r = dynamic_pointer_cast<ValueFloat>(rp))
         return valp(new ValueFloat(binop0((float)value, r->value, op)));
+    // number * vector scales the vector
+    if (op == "*" && dynamic_pointer_cast<ValueVec>(rp))
+        return rp->binop(op, valp(new ValueFloat(value)));
     throw runtime_error("Unsupported operation");
 }
 
@@ -114,12 +434,256 @@ valp ValueFloat::binop(string op, valp rp) {
         return valp(new ValueFloat(binop0(value, (float)r->value, op)));
     if (auto r = dynamic_pointer_cast<ValueFloat>(rp))
         return valp(new ValueFloat(binop0(value, r->value, op)));
+    // number * vector scales the vector
+    if (op == "*" && dynamic_pointer_cast<ValueVec>(rp))
+        return rp->binop(op, valp(new ValueFloat(value)));
     throw runtime_error("Unsupported operation");
 }
 
-// String concat
+struct StrIterator : public Iterator {
+    StrIterator(std::string_view s) : s(s) {}
+    virtual valp next() {
+        if (i >= s.size()) return nullptr;
+        return valp(new ValueStr(std::string(1, s[i++])));
+    }
+    std::string_view s;
+    size_t i = 0;
+};
+iterp ValueStr::iter() {
+    return iterp(new StrIterator(view()));
+}
+
+struct GeneratorIterator : public Iterator {
+    GeneratorIterator(ValueGenerator& g) : g(g) {}
+    virtual valp next() {
+        return g.next();
+    }
+    ValueGenerator& g;
+};
+iterp ValueGenerator::iter() {
+    return iterp(new GeneratorIterator(*this));
+}
+
 valp ValueStr::binop(string op, valp rp) {
-    if (auto r = dynamic_pointer_cast<ValueStr>(rp))
-        return valp(new ValueStr(value + r->value));
+    auto r = dynamic_pointer_cast<ValueStr>(rp);
+    if (!r) throw runtime_error("Unsupported operation");
+    if (op == "+") {
+        checkHeap(size + r->size + 1);
+        string s;
+        s.reserve(size + r->size);
+        s.append(data, size).append(r->data, r->size);
+        return valp(new ValueStr(move(s)));
+    }
+    int c = view().compare(r->view());
+    if (op == "==") return valp(new ValueInt(c == 0));
+    if (op == "!=") return valp(new ValueInt(c != 0));
+    if (op == "<") return valp(new ValueInt(c < 0));
+    if (op == "<=") return valp(new ValueInt(c <= 0));
+    if (op == ">") return valp(new ValueInt(c > 0));
+    if (op == ">=") return valp(new ValueInt(c >= 0));
     throw runtime_error("Unsupported operation");
+}
+valp ValueStr::at(int i) {
+    if (i < 0 || i >= size) throw runtime_error("Index out of range");
+    return valp(new ValueStr(string(1, data[i])));
+}
+valp& ValueStr::atRef(int i) {
+    throw runtime_error("Can't assign to string characters");
+}
+
+// Strings up to this size are stored in std::string without allocating
+static const size_t SHORT_STR = string().capacity();
+
+void ValueStr::chargeBytes() {
+    // short strings keep their bytes inside the value
+    auto p = value.data();
+    if (p >= (const char*)this && p < (const char*)(this + 1)) return;
+    account = StatsAccount::current;
+    if (!account) return;
+    charged = value.capacity() + 1;
+    account->charge(charged);
+}
+
+ValueStr::~ValueStr() {
+    if (account) heapCredit(account, charged);
+}
+
+const shared_ptr<const void>& ValueStr::share() {
+    if (!owner) {
+        // moving a string longer than SHORT_STR keeps its buffer, shorter ones
+        // are copied; the buffer stays counted until the last string viewing
+        // it is freed, possibly on another thread
+        auto a = account;
+        size_t bytes = charged;
+        account = nullptr;
+        charged = 0;
+        shared_ptr<const string> s(new string(move(value)), [a, bytes](const string* s) {
+            delete s;
+            if (a) heapCredit(a, bytes);
+        });
+        data = s->data();
+        owner = s;
+    }
+    return owner;
+}
+
+valp ValueStr::substr(size_t beg, size_t count) {
+    if (count <= SHORT_STR) return valp(new ValueStr(string(data + beg, count)));
+    return valp(new ValueStr(share(), data + beg, count));
+}
+
+// Position of n in h at or after pos, npos if none
+// With SSE2, 16 positions are tested at once on the first and last bytes of n
+// and only the candidates are compared (http://0x80.pl/articles/simd-strfind.html)
+static size_t findBytes(string_view h, string_view n, size_t pos) {
+    if (pos > h.size() || n.size() > h.size() - pos) return string_view::npos;
+    if (n.empty()) return pos;
+    if (n.size() == 1) {
+        auto p = (const char*)memchr(h.data() + pos, n[0], h.size() - pos);
+        return p ? p - h.data() : string_view::npos;
+    }
+#ifdef __SSE2__
+    const __m128i first = _mm_set1_epi8(n[0]);
+    const __m128i last = _mm_set1_epi8(n.back());
+    size_t k = n.size() - 1;
+    for (; pos + k + 16 <= h.size(); pos += 16) {
+        __m128i bf = _mm_loadu_si128((const __m128i*)(h.data() + pos));
+        __m128i bl = _mm_loadu_si128((const __m128i*)(h.data() + pos + k));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, bf), _mm_cmpeq_epi8(last, bl)));
+        while (mask) {
+            size_t i = pos + __builtin_ctz(mask);
+            if (memcmp(h.data() + i + 1, n.data() + 1, k - 1) == 0) return i;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    return h.find(n, pos);
+}
+
+static string_view strArg(vector<valp>& args, size_t i) {
+    auto s = dynamic_pointer_cast<ValueStr>(args[i]);
+    if (!s) throw runtime_error("Expected a string argument");
+    return s->view();
+}
+
+// String methods, by name
+static const map<string, valp (*)(ValueStr&, vector<valp>&)> strMethods = {
+    {"length", [](ValueStr& s, vector<valp>& a) {
+        checkArgs(a, 0);
+        return valp(new ValueInt(s.size));
+    }},
+    {"find", [](ValueStr& s, vector<valp>& a) {
+        if (a.size() != 1 && a.size() != 2) throw runtime_error("Unmatched argument number");
+        int from = a.size() == 2 ? a[1]->getInt() : 0;
+        if (from < 0) throw runtime_error("Index out of range");
+        size_t i = findBytes(s.view(), strArg(a, 0), from);
+        return valp(new ValueInt(i == string_view::npos ? -1 : (int)i));
+    }},
+    {"split", [](ValueStr& s, vector<valp>& a) {
+        checkArgs(a, 1);
+        auto sep = strArg(a, 0);
+        if (sep.empty()) throw runtime_error("Empty separator");
+        auto l = new ValueList({});
+        valp lp(l);
+        auto& parts = l->values();
+        size_t beg = 0;
+        while (true) {
+            size_t end = findBytes(s.view(), sep, beg);
+            if (end == string_view::npos) break;
+            parts.push_back(s.substr(beg, end - beg));
+            beg = end + sep.size();
+        }
+        parts.push_back(s.substr(beg, s.size - beg));
+        return lp;
+    }},
+    {"substr", [](ValueStr& s, vector<valp>& a) {
+        if (a.size() != 1 && a.size() != 2) throw runtime_error("Unmatched argument number");
+        int beg = a[0]->getInt();
+        if (beg < 0 || beg > s.size) throw runtime_error("Substring out of range");
+        size_t count = s.size - beg;
+        if (a.size() == 2) {
+            int c = a[1]->getInt();
+            if (c < 0) throw runtime_error("Substring out of range");
+            count = min(count, (size_t)c);
+        }
+        return s.substr(beg, count);
+    }},
+    {"startsWith", [](ValueStr& s, vector<valp>& a) {
+        checkArgs(a, 1);
+        auto p = strArg(a, 0);
+        return valp(new ValueInt(s.view().substr(0, p.size()) == p));
+    }},
+    {"replace", [](ValueStr& s, vector<valp>& a) {
+        checkArgs(a, 2);
+        auto from = strArg(a, 0), to = strArg(a, 1);
+        if (from.empty()) throw runtime_error("Empty string to replace");
+        // occurrences first, the size of the result is checked before allocating it
+        vector<size_t> found;
+        for (size_t i = findBytes(s.view(), from, 0); i != string_view::npos; i = findBytes(s.view(), from, i + from.size())) {
+            found.push_back(i);
+        }
+        size_t n = s.size - found.size() * from.size();
+        if (!to.empty() && found.size() > (SIZE_MAX - n) / to.size()) throw runtime_error("Out of memory");
+        n += found.size() * to.size();
+        checkHeap(n + 1);
+        string r;
+        r.reserve(n);
+        size_t beg = 0;
+        for (size_t end : found) {
+            r.append(s.data + beg, end - beg).append(to);
+            beg = end + from.size();
+        }
+        r.append(s.data + beg, s.size - beg);
+        return valp(new ValueStr(move(r)));
+    }},
+    {"join", [](ValueStr& s, vector<valp>& a) {
+        checkArgs(a, 1);
+        // parts first, the size of the result is checked before allocating it
+        vector<valp> strs;
+        deque<string> printed;
+        vector<string_view> parts;
+        size_t n = 0;
+        auto it = a[0]->iter();
+        while (auto v = it->next()) {
+            if (auto e = dynamic_pointer_cast<ValueStr>(v)) {
+                parts.push_back(e->view());
+                strs.push_back(v);
+            } else {
+                printed.push_back(v->print());
+                parts.push_back(printed.back());
+            }
+            n += parts.back().size();
+        }
+        size_t seps = parts.empty() ? 0 : parts.size() - 1;
+        if (s.size && seps > (SIZE_MAX - n) / s.size) throw runtime_error("Out of memory");
+        n += seps * s.size;
+        checkHeap(n + 1);
+        string r;
+        r.reserve(n);
+        for (size_t i=0;i<parts.size();i++) {
+            if (i) r.append(s.data, s.size);
+            r.append(parts[i]);
+        }
+        return valp(new ValueStr(move(r)));
+    }},
+    {"toInt", [](ValueStr& s, vector<valp>& a) {
+        checkArgs(a, 0);
+        int v;
+        auto r = from_chars(s.data, s.data + s.size, v);
+        if (s.size == 0 || r.ec != errc() || r.ptr != s.data + s.size) throw runtime_error("Not an int: " + s.getStr());
+        return valp(new ValueInt(v));
+    }},
+    {"toFloat", [](ValueStr& s, vector<valp>& a) {
+        checkArgs(a, 0);
+        float v;
+        auto r = from_chars(s.data, s.data + s.size, v);
+        if (s.size == 0 || r.ec != errc() || r.ptr != s.data + s.size) throw runtime_error("Not a float: " + s.getStr());
+        return valp(new ValueFloat(v));
+    }},
+};
+
+valp ValueStr::call(string f, vector<valp> args) {
+    auto it = strMethods.find(f);
+    if (it == strMethods.end()) throw runtime_error("Unknown method");
+    return it->second(*this, args);
 }
\ No newline at end of file
@@ -24,7 +24,7 @@ void ValueExtern<float>::assign(valp r) {
 template<>
 void ValueExtern<string>::assign(valp r) {
     if (auto rv = dynamic_pointer_cast<ValueStr>(r))
-        ref = rv->value;
+        ref = rv->getStr();
     else throw runtime_error("Uncompatible types");
 }
 
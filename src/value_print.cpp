@@ -25,11 +25,17 @@ string ValueMap::print() {
     return ss.str();
 }
 
+string ValueModule::print() {
+    load();
+    return ValueMap::print();
+}
+
 string ValueList::print() {
     std::stringstream ss; 
     ss << "[";
-    for (auto a : values) {
-        ss << a->print() << ",";
+    for (size_t i=0;i<size();i++) {
+        // holes print as None
+        ss << ((*this)[i] ? (*this)[i]->print() : "None") << ",";
     }
     ss << "]";
     return ss.str();
@@ -45,7 +51,7 @@ string ValueRange::print() {
 
 string ValueStr::print() {
     std::stringstream ss;
-    ss << "\"" << value << "\"";
+    ss << "\"" << view() << "\"";
     return ss.str();
 }
 
@@ -57,4 +63,15 @@ string ValueFunction::print() {
 
 std::string ValueNativeFunc::print() {
     return "nativefunction";
-}
\ No newline at end of file
+}
+std::string ValueGenerator::print() {
+    return "generator";
+}
+
+std::string ValueFile::print() {
+    return "file(\"" + path + "\")";
+}
+
+std::string ValueWriter::print() {
+    return "writer(\"" + path + "\")";
+}
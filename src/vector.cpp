@@ -0,0 +1,243 @@
+#include <ascript/script.h>
+#include <sstream>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+using namespace std;
+
+// Operations on 4 floats at once, loaded from and stored to 16 bytes aligned
+// memory like the components of vectors and matrices
+#ifdef __SSE__
+using f4 = __m128;
+static f4 load(const float* p) { return _mm_load_ps(p); }
+static void store(float* p, f4 a) { _mm_store_ps(p, a); }
+static f4 splat(float x) { return _mm_set1_ps(x); }
+static f4 add(f4 a, f4 b) { return _mm_add_ps(a, b); }
+static f4 sub(f4 a, f4 b) { return _mm_sub_ps(a, b); }
+static f4 mul(f4 a, f4 b) { return _mm_mul_ps(a, b); }
+static f4 div(f4 a, f4 b) { return _mm_div_ps(a, b); }
+#else
+struct f4 { float v[4]; };
+static f4 load(const float* p) { return {{p[0], p[1], p[2], p[3]}}; }
+static void store(float* p, f4 a) { for (int i=0;i<4;i++) p[i] = a.v[i]; }
+static f4 splat(float x) { return {{x, x, x, x}}; }
+static f4 add(f4 a, f4 b) { for (int i=0;i<4;i++) a.v[i] += b.v[i]; return a; }
+static f4 sub(f4 a, f4 b) { for (int i=0;i<4;i++) a.v[i] -= b.v[i]; return a; }
+static f4 mul(f4 a, f4 b) { for (int i=0;i<4;i++) a.v[i] *= b.v[i]; return a; }
+static f4 div(f4 a, f4 b) { for (int i=0;i<4;i++) a.v[i] /= b.v[i]; return a; }
+#endif
+
+// <cmath> can't be included with the AST names (expl)
+static float sqrt(float x) { return __builtin_sqrtf(x); }
+
+static float dot(const float* a, const float* b) {
+    alignas(16) float p[4];
+    store(p, mul(load(a), load(b)));
+    return p[0] + p[1] + p[2] + p[3];
+}
+
+// r = a * b, 4x4 column major matrices, r can't be a or b
+static void matMul(const float* a, const float* b, float* r, int columns) {
+    for (int j=0;j<columns;j++) {
+        f4 c = mul(load(a), splat(b[j*4]));
+        for (int k=1;k<4;k++) c = add(c, mul(load(a + k*4), splat(b[j*4 + k])));
+        store(r + j*4, c);
+    }
+}
+
+static float number(const valp& v) {
+    if (auto i = dynamic_cast<ValueInt*>(v.get())) return i->value;
+    if (auto f = dynamic_cast<ValueFloat*>(v.get())) return f->value;
+    throw runtime_error("Expected a number");
+}
+
+static int component(const string& mem, int n) {
+    int i = mem.size() == 1 ? string("xyzw").find(mem[0]) : -1;
+    if (i < 0 || i >= n) throw runtime_error("Unknown component " + mem);
+    return i;
+}
+
+// Reference to component mem of n floats at data, valid until the next call
+// Assignments use it right away
+static valp& componentRef(float* data, int n, const string& mem) {
+    thread_local valp ref;
+    ref = valp(new ValueExtern<float>(data[component(mem, n)]));
+    return ref;
+}
+
+static valp makeVec(int n, const float* v) {
+    auto r = new ValueVec(n);
+    for (int i=0;i<n;i++) r->v[i] = v[i];
+    return valp(r);
+}
+
+valp ValueVec::binop(string op, valp rp) {
+    auto r = new ValueVec(n);
+    valp result(r);
+    if (auto o = dynamic_cast<ValueVec*>(rp.get())) {
+        if (o->n != n) throw runtime_error("Vectors of different sizes");
+        f4 a = load(v), b = load(o->v);
+        if (op == "+") store(r->v, add(a, b));
+        else if (op == "-") store(r->v, sub(a, b));
+        else if (op == "*") store(r->v, mul(a, b));
+        else if (op == "/") store(r->v, div(a, b));
+        else if (op == "==" || op == "!=") {
+            bool eq = equal(v, v + n, o->v);
+            return valp(new ValueInt(op == "==" ? eq : !eq));
+        }
+        else throw runtime_error("Unsupported operation");
+    } else if (op == "*") {
+        store(r->v, mul(load(v), splat(number(rp))));
+    } else if (op == "/") {
+        store(r->v, div(load(v), splat(number(rp))));
+    } else throw runtime_error("Unsupported operation");
+    // unused components may have been divided by 0
+    for (int i=n;i<4;i++) r->v[i] = 0;
+    return result;
+}
+
+valp ValueVec::at(int i) {
+    if (i < 0 || i >= n) throw runtime_error("Index out of range");
+    return valp(new ValueFloat(v[i]));
+}
+
+valp ValueVec::get(string mem) {
+    return valp(new ValueFloat(v[component(mem, n)]));
+}
+
+valp& ValueVec::getRef(string mem) {
+    return componentRef(v, n, mem);
+}
+
+valp ValueVec::call(string f, vector<valp> args) {
+    if (f == "length" && args.size() == 0) {
+        return valp(new ValueFloat(sqrt(dot(v, v))));
+    }
+    if (f == "normalize" && args.size() == 0) {
+        float l = sqrt(dot(v, v));
+        if (l == 0) throw runtime_error("Can't normalize a zero vector");
+        auto r = new ValueVec(n);
+        store(r->v, div(load(v), splat(l)));
+        return valp(r);
+    }
+    if ((f == "dot" || f == "cross") && args.size() == 1) {
+        auto o = dynamic_cast<ValueVec*>(args[0].get());
+        if (!o || o->n != n) throw runtime_error("Expected a vector of the same size");
+        if (f == "dot") return valp(new ValueFloat(dot(v, o->v)));
+        if (n != 3) throw runtime_error("Cross product of vectors other than vec3");
+        float c[3] = {
+            v[1]*o->v[2] - v[2]*o->v[1],
+            v[2]*o->v[0] - v[0]*o->v[2],
+            v[0]*o->v[1] - v[1]*o->v[0]
+        };
+        return makeVec(3, c);
+    }
+    throw runtime_error("Unknown method");
+}
+
+string ValueVec::print() {
+    stringstream ss;
+    ss << "vec" << n << "(";
+    for (int i=0;i<n;i++) ss << (i ? ", " : "") << v[i];
+    ss << ")";
+    return ss.str();
+}
+
+valp ValueMat::binop(string op, valp rp) {
+    if (op != "*") throw runtime_error("Unsupported operation");
+    if (auto o = dynamic_cast<ValueMat*>(rp.get())) {
+        auto r = new ValueMat();
+        valp result(r);
+        matMul(m, o->m, r->m, 4);
+        return result;
+    }
+    if (auto o = dynamic_cast<ValueVec*>(rp.get())) {
+        if (o->n != 4) throw runtime_error("Matrices only transform vec4");
+        auto r = new ValueVec(4);
+        valp result(r);
+        matMul(m, o->v, r->v, 1);
+        return result;
+    }
+    throw runtime_error("Unsupported operation");
+}
+
+valp ValueMat::at(int i) {
+    if (i < 0 || i >= 4) throw runtime_error("Index out of range");
+    return makeVec(4, m + i*4);
+}
+
+valp ValueMat::call(string f, vector<valp> args) {
+    if (f == "transpose" && args.size() == 0) {
+        auto r = new ValueMat();
+        for (int i=0;i<4;i++) {
+            for (int j=0;j<4;j++) r->m[i*4 + j] = m[j*4 + i];
+        }
+        return valp(r);
+    }
+    throw runtime_error("Unknown method");
+}
+
+string ValueMat::print() {
+    stringstream ss;
+    ss << "mat4(";
+    for (int i=0;i<16;i++) ss << (i ? ", " : "") << m[i];
+    ss << ")";
+    return ss.str();
+}
+
+void ValueVecExtern::assign(valp r) {
+    if (auto o = dynamic_cast<ValueVec*>(r.get())) {
+        if (o->n == n) {
+            copy(o->v, o->v + n, data);
+            return;
+        }
+    } else if (auto o = dynamic_cast<ValueMat*>(r.get())) {
+        if (n == 16) {
+            copy(o->m, o->m + 16, data);
+            return;
+        }
+    }
+    throw runtime_error("Uncompatible types");
+}
+
+valp ValueVecExtern::get() {
+    if (n == 16) {
+        auto r = new ValueMat();
+        copy(data, data + 16, r->m);
+        return valp(r);
+    }
+    return makeVec(n, data);
+}
+
+valp& ValueVecExtern::getRef(string mem) {
+    if (n == 16) throw runtime_error("Matrices have no components");
+    return componentRef(data, n, mem);
+}
+
+string ValueVecExtern::print() {
+    return get()->print();
+}
+
+void addVectorFunctions(valp vars) {
+    for (int n=2;n<=4;n++) {
+        vars->getRef("vec" + to_string(n)) = valp(new ValueNativeFunc([n](vector<valp> a) {
+            if (a.size() != n) throw runtime_error("Unmatched argument number");
+            auto r = new ValueVec(n);
+            valp result(r);
+            for (int i=0;i<n;i++) r->v[i] = number(a[i]);
+            return result;
+        }));
+    }
+    vars->getRef("mat4") = valp(new ValueNativeFunc([](vector<valp> a) {
+        auto r = new ValueMat();
+        valp result(r);
+        if (a.size() == 0) {
+            for (int i=0;i<4;i++) r->m[i*5] = 1;
+        } else if (a.size() == 16) {
+            for (int i=0;i<16;i++) r->m[i] = number(a[i]);
+        } else throw runtime_error("Unmatched argument number");
+        return result;
+    }));
+}
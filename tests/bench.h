@@ -0,0 +1,11 @@
+#pragma once
+
+#include <chrono>
+
+// Seconds taken by f()
+template <typename F>
+double measure(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,23 @@
+fib = function(n) return n if n < 2 else fib(n-1) + fib(n-2)
+
+// Points of a size x size grid in the Mandelbrot set
+mandelbrot = function(size) {
+    count = 0
+    for y in [0..size-1] {
+        for x in [0..size-1] {
+            cr = x * 3.0 / size - 2
+            ci = y * 2.0 / size - 1
+            zr = 0.0
+            zi = 0.0
+            steps = 0.0
+            while steps < 50 and zr*zr + zi*zi < 4 {
+                t = zr*zr - zi*zi + cr
+                zi = 2*zr*zi + ci
+                zr = t
+                steps += 1
+            }
+            if steps == 50 count += 1
+        }
+    }
+    return count
+}
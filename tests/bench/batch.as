@@ -0,0 +1,4 @@
+update = function(x, y) {
+    if x > y return x - y
+    return x + y*2
+}
@@ -0,0 +1,20 @@
+// Sends n ones on out
+produce = function(out, n) {
+    i = 0
+    while i < n {
+        out.send(1)
+        i = i+1
+    }
+    return n
+}
+
+// Receives n numbers on input, returns their sum
+consume = function(input, n) {
+    s = 0
+    i = 0
+    while i < n {
+        s = s + input.receive()
+        i = i+1
+    }
+    return s
+}
@@ -0,0 +1,5 @@
+// Raises an error when x is negative, hosts catch it as a signal
+check = function(x) {
+    assert(x >= 0)
+    return x
+}
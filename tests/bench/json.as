@@ -0,0 +1,2 @@
+// Number of events in a JSON array, parsed one event at a time
+countEvents = function(text) return parseJson(text, function(e) return 0)
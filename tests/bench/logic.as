@@ -0,0 +1,30 @@
+expensive = function(i) {
+    s = 0
+    for j in [1..20] {
+        s = s + j
+    }
+    return s > i
+}
+
+// `and` skips expensive(i) since i < 0 is false
+guarded = function(n) {
+    c = 0
+    i = 0
+    while i < n {
+        if i < 0 and expensive(i) c = c+1
+        i = i+1
+    }
+    return c
+}
+
+// evaluates both operands, as before `and` short-circuited
+eager = function(n) {
+    c = 0
+    i = 0
+    while i < n {
+        e = expensive(i)
+        if i < 0 and e c = c+1
+        i = i+1
+    }
+    return c
+}
@@ -0,0 +1,5 @@
+// Position of the needle in text
+locate = function(text) return text.find("needle")
+
+// Number of fields in a line of comma separated values
+fields = function(line) return line.split(",").length()
@@ -0,0 +1,29 @@
+// n steps of a particle falling and bouncing off the ground, returns its height
+
+maps = function(n) {
+    p = {x = 0 y = 10 z = 0}
+    v = {x = 1 y = 0 z = 0.5}
+    g = {x = 0 y = -9.8 z = 0}
+    i = 0
+    while i < n {
+        v = {x = v.x + g.x * 0.01 y = v.y + g.y * 0.01 z = v.z + g.z * 0.01}
+        p = {x = p.x + v.x * 0.01 y = p.y + v.y * 0.01 z = p.z + v.z * 0.01}
+        if p.y < 0 v.y = 0 - v.y
+        i = i+1
+    }
+    return p.y
+}
+
+vectors = function(n) {
+    p = vec3(0, 10, 0)
+    v = vec3(1, 0, 0.5)
+    g = vec3(0, -9.8, 0)
+    i = 0
+    while i < n {
+        v = v + g * 0.01
+        p = p + v * 0.01
+        if p.y < 0 v.y = 0 - v.y
+        i = i+1
+    }
+    return p.y
+}
@@ -0,0 +1,40 @@
+#include <ascript/script.h>
+#include <iostream>
+#include <fstream>
+#include "bench.h"
+
+using namespace std;
+
+// Compares tests/bench/aot.as compiled by ascriptc with the same script interpreted
+
+const int FIB = 24;
+const int SIZE = 100;
+
+int main(void) {
+    // a copy of the script isn't compiled, it is parsed and interpreted
+    {
+        ifstream in("tests/bench/aot.as");
+        ofstream out("bench_aot.as");
+        out << in.rdbuf();
+    }
+    Script compiled("tests/bench/aot.as");
+    Script interpreted("bench_aot.as");
+    remove("bench_aot.as");
+    compiled.run();
+    interpreted.run();
+    for (auto name : {"fib", "mandelbrot"}) {
+        int n = name == string("fib") ? FIB : SIZE;
+        auto fc = compiled.getFunction<int(int)>(name);
+        auto fi = interpreted.getFunction<int(int)>(name);
+        int rc, ri;
+        double tc = measure([&]() { rc = fc(n); });
+        double ti = measure([&]() { ri = fi(n); });
+        if (rc != ri) {
+            cerr << "wrong results " << rc << " " << ri << endl;
+            return 1;
+        }
+        cout << name << "(" << n << "): interpreted " << ti*1e3 << " ms, compiled "
+             << tc*1e3 << " ms (" << ti/tc << "x)" << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,43 @@
+#include <ascript/script.h>
+#include <iostream>
+#include "bench.h"
+
+using namespace std;
+
+// Compares calling a script function per item from C++, through a handle and with Script::callBatch
+
+const size_t N = 100000;
+
+int main(void) {
+    vector<int> xs(N), ys(N), loop(N), handle(N), batch(N);
+    for (size_t i=0;i<N;i++) {
+        xs[i] = i % 1000;
+        ys[i] = (i * 7) % 1000;
+    }
+    for (int jit=0;jit<2;jit++) {
+        Script script("tests/bench/batch.as");
+        script.setJit(jit);
+        script.run();
+        double tloop = measure([&]() {
+            for (size_t i=0;i<N;i++) {
+                loop[i] = convert<int>(script.call("update", {convertRet(xs[i]), convertRet(ys[i])}));
+            }
+        });
+        double thandle = measure([&]() {
+            auto update = script.getFunction<int(int, int)>("update");
+            for (size_t i=0;i<N;i++) {
+                handle[i] = update(xs[i], ys[i]);
+            }
+        });
+        double tbatch = measure([&]() {
+            script.callBatch("update", N, batch.data(), xs.data(), ys.data());
+        });
+        if (loop != batch || loop != handle) {
+            cerr << "results differ" << endl;
+            return 1;
+        }
+        cout << (jit ? "jit " : "tree") << " loop: " << tloop*1e9/N << " ns/call, handle: "
+             << thandle*1e9/N << " ns/call, batch: " << tbatch*1e9/N << " ns/call" << endl;
+    }
+    return 0;
+}
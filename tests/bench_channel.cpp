@@ -0,0 +1,42 @@
+#include <ascript/script.h>
+#include <iostream>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+// Throughput of a channel with 1 to 15 scripts sending to one receiving
+// script, each script on its own thread
+
+const int N = 400000;
+
+int main(void) {
+    for (int threads : {2, 4, 8, 16}) {
+        int senders = threads - 1;
+        int n = N / senders;
+        auto channel = make_shared<Channel>(1024);
+        valp vchannel(new ValueChannel(channel));
+        vector<unique_ptr<Script>> scripts;
+        for (int i=0;i<threads;i++) {
+            scripts.emplace_back(new Script("tests/bench/channel.as"));
+            scripts.back()->run();
+        }
+        auto start = chrono::steady_clock::now();
+        vector<thread> ts;
+        for (int i=0;i<senders;i++) {
+            ts.emplace_back([&, i]() {
+                scripts[i]->call("produce", {vchannel, valp(new ValueInt(n))});
+            });
+        }
+        int total = n * senders;
+        valp sum = scripts.back()->call("consume", {vchannel, valp(new ValueInt(total))});
+        for (auto& t : ts) t.join();
+        double t = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (sum->getInt() != total) {
+            cerr << "wrong sum" << endl;
+            return 1;
+        }
+        cout << threads << " threads: " << total / t / 1e6 << " M messages/s" << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,41 @@
+#include <ascript/script.h>
+#include <iostream>
+#include "bench.h"
+
+using namespace std;
+
+// Compares catching script errors with and without formatting their message
+
+const int N = 20000;
+
+int main(void) {
+    Script script("tests/bench/error.as");
+    script.run();
+    vector<valp> args = {valp(new ValueInt(-1))};
+    size_t lines = 0, length = 0;
+    double tcaught = measure([&]() {
+        for (int i=0;i<N;i++) {
+            try {
+                script.call("check", args);
+            } catch (InterpreterError& e) {
+                lines += e.where().line;
+            }
+        }
+    });
+    double tformatted = measure([&]() {
+        for (int i=0;i<N;i++) {
+            try {
+                script.call("check", args);
+            } catch (InterpreterError& e) {
+                length += string(e.what()).size();
+            }
+        }
+    });
+    if (lines != 3*N || length == 0) {
+        cerr << "wrong results" << endl;
+        return 1;
+    }
+    cout << "caught: " << tcaught*1e9/N << " ns/error, formatted: "
+         << tformatted*1e9/N << " ns/error (" << tformatted/tcaught << "x)" << endl;
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include <ascript/script.h>
+#include <iostream>
+#include "bench.h"
+
+#ifdef HAVE_JSONCPP
+#include <json/json.h>
+#endif
+
+using namespace std;
+
+// Parses and writes a corpus of event records, compared with jsoncpp when the
+// Makefile finds it
+
+const int N = 20;
+const int EVENTS = 20000;
+
+// Events as a game server would log them: names, numbers, nested objects,
+// arrays and some escaped text
+static string corpus() {
+    static const char* types[] = {"move", "hit", "chat", "spawn"};
+    string s = "[";
+    unsigned seed = 1;
+    auto rnd = [&]() { return seed = seed * 1103515245 + 12345, (seed >> 16) & 0x7fff; };
+    for (int i=0;i<EVENTS;i++) {
+        if (i) s += ",\n";
+        s += "{\"id\": " + to_string(i) + ", \"type\": \"" + types[rnd() % 4] + "\"";
+        s += ", \"player\": {\"name\": \"player_" + to_string(rnd()) + "\", \"level\": " + to_string(rnd() % 100) + "}";
+        s += ", \"position\": [" + to_string(rnd() / 100.0) + ", " + to_string(rnd() / 100.0) + ", " + to_string(rnd() / 100.0) + "]";
+        s += ", \"tags\": [\"ranked\", \"season_" + to_string(rnd() % 8) + "\"], \"alive\": true";
+        s += ", \"message\": \"gg \\\"well\\\" played\\nsee you in the next round, it was a long one\"}";
+    }
+    return s + "]";
+}
+
+int main(void) {
+    string text = corpus();
+    double mb = text.size() * N / 1e6;
+    valp doc;
+    double tparse = measure([&]() {
+        for (int i=0;i<N;i++) doc = fromJson(text);
+    });
+    string out;
+    double twrite = measure([&]() {
+        for (int i=0;i<N;i++) {
+            out.clear();
+            toJson(out, doc);
+        }
+    });
+    if (doc->length() != EVENTS || fromJson(out)->length() != EVENTS) {
+        cerr << "wrong results" << endl;
+        return 1;
+    }
+    cout << "parse: " << mb/tparse << " MB/s, write: " << out.size()*N/1e6/twrite << " MB/s" << endl;
+
+    Script script("tests/bench/json.as");
+    script.run();
+    vector<valp> args = {valp(new ValueStr(text))};
+    double tstream = measure([&]() {
+        for (int i=0;i<N;i++) {
+            if (script.call("countEvents", args)->getInt() != EVENTS) throw runtime_error("wrong count");
+        }
+    });
+    cout << "streaming parse with a script callback: " << mb/tstream << " MB/s" << endl;
+
+#ifdef HAVE_JSONCPP
+    Json::CharReaderBuilder builder;
+    unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    Json::Value root;
+    double tjsoncpp = measure([&]() {
+        for (int i=0;i<N;i++) {
+            string errors;
+            if (!reader->parse(text.data(), text.data() + text.size(), &root, &errors)) throw runtime_error(errors);
+        }
+    });
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "";
+    string jout;
+    double tjsoncppWrite = measure([&]() {
+        for (int i=0;i<N;i++) jout = Json::writeString(writer, root);
+    });
+    cout << "jsoncpp parse: " << mb/tjsoncpp << " MB/s (" << tjsoncpp/tparse << "x), write: "
+         << jout.size()*N/1e6/tjsoncppWrite << " MB/s (" << tjsoncppWrite/twrite << "x)" << endl;
+#endif
+    return 0;
+}
@@ -0,0 +1,32 @@
+#include <ascript/script.h>
+#include <iostream>
+#include <chrono>
+#include <experimental/filesystem>
+
+using namespace std;
+
+// Time to load 800 script files, one by one then with Script::loadAll on
+// 1 to 8 threads
+
+const int N = 800;
+
+int main(void) {
+    vector<string> files;
+    for (auto& de : experimental::filesystem::directory_iterator("tests/scripts")) files.push_back(de.path());
+    vector<string> paths;
+    for (int i=0;i<N;i++) paths.push_back(files[i % files.size()]);
+
+    auto start = chrono::steady_clock::now();
+    vector<unique_ptr<Script>> scripts;
+    for (auto& p : paths) scripts.emplace_back(new Script(p));
+    double serial = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "one by one: " << serial * 1e3 << " ms" << endl;
+
+    for (int threads : {1, 2, 4, 8}) {
+        start = chrono::steady_clock::now();
+        auto loaded = Script::loadAll(paths, threads);
+        double t = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << threads << " threads: " << t * 1e3 << " ms (" << serial / t << "x)" << endl;
+    }
+    return 0;
+}
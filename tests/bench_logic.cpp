@@ -0,0 +1,26 @@
+#include <ascript/script.h>
+#include <iostream>
+#include "bench.h"
+
+using namespace std;
+
+// Compares a guard `i < 0 and expensive(i)` with evaluating both operands
+
+const int N = 20000;
+
+int main(void) {
+    Script script("tests/bench/logic.as");
+    script.run();
+    auto guarded = script.getFunction<int(int)>("guarded");
+    auto eager = script.getFunction<int(int)>("eager");
+    int c1, c2;
+    double tguarded = measure([&]() { c1 = guarded(N); });
+    double teager = measure([&]() { c2 = eager(N); });
+    if (c1 != 0 || c2 != 0) {
+        cerr << "wrong results" << endl;
+        return 1;
+    }
+    cout << "short-circuit: " << tguarded*1e9/N << " ns/iteration, both operands: "
+         << teager*1e9/N << " ns/iteration (" << teager/tguarded << "x)" << endl;
+    return 0;
+}
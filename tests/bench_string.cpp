@@ -0,0 +1,47 @@
+#include <ascript/script.h>
+#include <iostream>
+#include "bench.h"
+
+using namespace std;
+
+// Compares the string find method with std::string_view::find on a large text,
+// and times split on a line of many fields
+
+const int N = 200;
+const size_t SIZE = 1 << 20;
+
+int main(void) {
+    Script script("tests/bench/string.as");
+    script.run();
+    string text;
+    while (text.size() < SIZE) text += "abcdefghijklmnopqrstuvwxyz the needl is missing ";
+    size_t expected = text.size();
+    text += "needle";
+    vector<valp> args = {valp(new ValueStr(text))};
+    bool ok = true;
+    double tscript = measure([&]() {
+        for (int i=0;i<N;i++) ok &= script.call("locate", args)->getInt() == (int)expected;
+    });
+    string_view view = text;
+    // keeps the search from being hoisted out of the loop
+    volatile size_t from = 0;
+    double tstd = measure([&]() {
+        for (int i=0;i<N;i++) ok &= view.find("needle", from) == expected;
+    });
+
+    string line = "field";
+    for (int i=0;i<999;i++) line += ",field";
+    vector<valp> largs = {valp(new ValueStr(line))};
+    double tsplit = measure([&]() {
+        for (int i=0;i<N;i++) ok &= script.call("fields", largs)->getInt() == 1000;
+    });
+    if (!ok) {
+        cerr << "wrong results" << endl;
+        return 1;
+    }
+    double bytes = (double)text.size() * N;
+    cout << "find: " << bytes/tscript/1e9 << " GB/s, string_view::find: " << bytes/tstd/1e9
+         << " GB/s (" << tstd/tscript << "x)" << endl;
+    cout << "split: " << tsplit*1e9/N/1000 << " ns/field" << endl;
+    return 0;
+}
@@ -0,0 +1,25 @@
+#include <ascript/script.h>
+#include <iostream>
+#include "bench.h"
+
+using namespace std;
+
+// Compares the same particle simulation written with {x y z} maps and with vec3
+
+const int N = 200000;
+
+int main(void) {
+    Script script("tests/bench/vector.as");
+    script.run();
+    vector<valp> args = {valp(new ValueInt(N))};
+    valp ymaps, yvectors;
+    double tmaps = measure([&]() { ymaps = script.call("maps", args); });
+    double tvectors = measure([&]() { yvectors = script.call("vectors", args); });
+    if (ymaps->binop("==", yvectors)->isTrue() == false) {
+        cerr << "wrong results " << ymaps->print() << " " << yvectors->print() << endl;
+        return 1;
+    }
+    cout << "maps: " << tmaps*1e9/N << " ns/step, vec3: " << tvectors*1e9/N
+         << " ns/step (" << tmaps/tvectors << "x)" << endl;
+    return 0;
+}
@@ -0,0 +1,6 @@
+f = function(x) {
+    l = [x, 2]
+    return l[0] + "a"
+}
+
+f(1)
\ No newline at end of file
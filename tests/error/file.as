@@ -0,0 +1,2 @@
+for line in lines("tests/error/missing_file") {
+}
@@ -0,0 +1,11 @@
+again = function(box) {
+    yield 1
+    for x in box[0] {
+        yield x
+    }
+}
+box = []
+g = again(box)
+box.push(g)
+for x in g {
+}
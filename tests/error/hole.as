@@ -0,0 +1,4 @@
+l = []
+l[100] = 1
+// holes have no value to update
+l[5] += 1
@@ -0,0 +1,3 @@
+l = []
+l[100] = {x = 1}
+l[5].x = 2
@@ -0,0 +1 @@
+import "../modules/missing.as" as missing
\ No newline at end of file
@@ -0,0 +1 @@
+doc = parseJson('{"a": [1, 2,]}')
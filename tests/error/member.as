@@ -0,0 +1,4 @@
+a = 3
+if a > 2 {
+    a.b = 4
+}
\ No newline at end of file
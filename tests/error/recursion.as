@@ -0,0 +1,3 @@
+f = function(n) return 1 + f(n+1)
+
+f(0)
\ No newline at end of file
@@ -0,0 +1 @@
+n = "12a".toInt()
@@ -0,0 +1,2 @@
+a = vec3(1, 2, 3)
+b = a + vec2(1, 2)
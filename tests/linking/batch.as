@@ -0,0 +1,7 @@
+score = function(x, y) {
+    if y > x return y*10 + x
+    return x*10 + y
+}
+
+scale = function(v, k) return v*k
+
@@ -0,0 +1,8 @@
+// answers requests until a negative n is received
+r = requests.receive()
+while r.n >= 0 {
+    replies.send({n = r.n * 2 tags = [r.name, r.name.length()]})
+    r = requests.receive()
+}
+// nothing is left after the last request
+assert(not requests.tryReceive())
@@ -0,0 +1,4 @@
+check = function(x) {
+    assert(x >= 0)
+    return x
+}
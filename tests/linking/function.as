@@ -0,0 +1,6 @@
+add = function(a, b) return a + b
+half = function(x) return x / 2
+sum = function(n) return 0 if n == 0 else n + again(n-1)
+notify = function(x) {
+    this.last = x
+}
@@ -0,0 +1,7 @@
+naturals = function() {
+    i = 0
+    while 1 {
+        yield i
+        i = i+1
+    }
+}
@@ -0,0 +1,4 @@
+ready = function() {
+    import "../modules/broken.as" as broken
+    return broken.ready
+}
@@ -0,0 +1,44 @@
+// strings past the memory limit set by the test
+long = function() {
+    s = "0123456789"
+    while s.length() < 1000000 {
+        s = s + s
+    }
+    return s
+}
+joined = function() return long().join([0..100])
+replaced = function() return long().replace("0", long())
+doubled = function() {
+    s = long()
+    while true {
+        s = s + s
+    }
+}
+encoded = function() {
+    s = long()
+    l = []
+    while true {
+        l.push(s)
+        toJson(l)
+    }
+}
+// keeps a line of every block read
+kept = function(path) {
+    out = writer(path)
+    line = "0123456789"
+    while line.length() < 1000 {
+        line = line + line
+    }
+    i = 0
+    while i < 24000 {
+        out.writeLine(line)
+        i += 1
+    }
+    out.close()
+    l = []
+    i = 0
+    for x in lines(path) {
+        if i % 1000 == 0 l.push(x)
+        i += 1
+    }
+}
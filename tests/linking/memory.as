@@ -0,0 +1,5 @@
+// grows a list until the memory limit set by the test stops it
+big = []
+while true {
+    big.push([1, 2, 3])
+}
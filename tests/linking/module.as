@@ -0,0 +1,4 @@
+import "module.so" as native
+
+assert(native.square(f(5, 1)) == 16)
+a = native.greet("world")
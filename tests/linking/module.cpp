@@ -0,0 +1,7 @@
+#include <ascript/script.h>
+
+// Native module imported by tests/linking/module.as
+extern "C" void ascript_register(ValueMap& module) {
+    module.getRef("square") = wrapFunction<int(int)>([](int x) { return x*x; });
+    module.getRef("greet") = wrapFunction<std::string(std::string)>([](std::string s) { return "hello " + s; });
+}
@@ -0,0 +1,7 @@
+// changed by the test between reloads
+runs += 1
+step = function(x) return x + 1
+keep = function(x) return x * 10
+steps = {
+    twice = function(x) return step(step(x))
+}
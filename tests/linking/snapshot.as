@@ -0,0 +1,42 @@
+if not restored {
+    table = {
+        name = "lookup"
+        range = [0..10..2]
+        get = function(i) return this.squares[i]
+    }
+    squares = []
+    i = 0
+    while i < 100 {
+        squares[i] = i*i
+        i += 1
+    }
+    table.squares = squares
+    table.again = squares
+    table.self = table
+    ids = []
+    ids[1000000] = table
+    import "../modules/geometry.as" as geo
+    area = geo.area
+    // module state is restored, not initialized again
+    geo.unit = 5
+    double = memoize(function(x) return x*2, 10)
+    memos = [double]
+    double(1)
+}
+
+assert(table.get(7) == 49)
+// lists shared before the snapshot are still shared
+table.again[1] = 2
+assert(table.squares[1] == 2)
+assert(table.self.range[1] == 2)
+assert(table.range[2] == 4)
+assert(ids.length() == 1000001)
+assert(ids[1000000].get(2) == 4)
+assert(ids.indices().length() == 1)
+assert(geo.square(3) == 9)
+assert(area(2, 3) == 6)
+assert(geo.unit == 5)
+// memos keep their function and are shared, their results are cached again
+assert(double(4) == 8)
+m = memos[0]
+assert(m.size() == (1 if restored else 2))
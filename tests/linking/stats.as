@@ -0,0 +1,7 @@
+square = function(x) return x * x
+fail = function() assert(0)
+total = 0
+for i in [1..10] {
+    total += square(i)
+}
+assert(total == 385)
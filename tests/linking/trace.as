@@ -0,0 +1,8 @@
+square = function(x) return x * x
+shapes = {area = function(w) return square(w)}
+total = 0
+for i in [1..3] {
+    total += shapes.area(i)
+}
+found = [1, 2, 3].find(2)
+fail = function() assert(0)
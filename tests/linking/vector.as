@@ -0,0 +1,4 @@
+// moves the host position by its velocity
+position += velocity * 2
+position.y = 0
+transform = mat4()
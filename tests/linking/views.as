@@ -0,0 +1,8 @@
+// view of a long string which is freed before the view
+part = function() {
+    s = "0123456789"
+    while s.length() < 100000 {
+        s = s + s
+    }
+    return s.substr(1, 100)
+}
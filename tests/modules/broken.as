@@ -0,0 +1,4 @@
+// fails half way through loading
+ready = 0
+parts = [1, 2]
+ready = parts[2]
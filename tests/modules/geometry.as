@@ -0,0 +1,11 @@
+unit = 1
+
+area = function(w, h) return w*h
+
+// calls module function from module code
+square = function(s) return area(s, s)
+
+cube = function(s) {
+    assert(s > 0)
+    return square(s) * s
+}
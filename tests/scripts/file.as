@@ -0,0 +1,29 @@
+out = writer("test_file")
+for i in [1..100] {
+    out.writeLine(i)
+}
+out.write("last")
+out.close()
+
+// lines are read without their newline
+n = 0
+chars = 0
+for line in lines("test_file") {
+    n = n + 1
+    for c in line {
+        chars = chars + 1
+    }
+}
+assert(n == 101)
+assert(chars == 196)
+
+n = 0
+chars = 0
+for r in records("test_file", 10) {
+    n = n + 1
+    for c in r {
+        chars = chars + 1
+    }
+}
+assert(n == 30)
+assert(chars == 296)
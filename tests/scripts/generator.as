@@ -0,0 +1,80 @@
+count = function(n) {
+    i = 0
+    while i < n {
+        yield i
+        i = i+1
+    }
+}
+
+naturals = function() {
+    i = 0
+    while 1 {
+        yield i
+        i = i+1
+    }
+}
+
+squares = function(g) {
+    for x in g {
+        yield x*x
+    }
+}
+
+first = function(g, min) {
+    for x in g {
+        if x >= min return x
+    }
+    return -1
+}
+
+sum = 0
+for x in count(10000) {
+    sum = sum + x
+}
+assert(sum == 49995000)
+
+total = 0
+for y in squares(count(5)) {
+    total = total + y
+}
+assert(total == 30)
+
+// generators stop at the first value needed
+assert(first(naturals(), 3) == 3)
+assert(first(squares(naturals()), 50) == 64)
+assert(first(count(3), 5) == -1)
+
+// a generator is consumed once
+g = count(4)
+assert(first(g, 1) == 1)
+assert(first(g, 0) == 2)
+
+obj = {
+    n = 3
+    items = function() {
+        i = 0
+        while i < this.n {
+            yield i
+            i = i+1
+        }
+    }
+}
+n = 0
+for x in obj.items() {
+    n = n + 1
+}
+assert(n == 3)
+
+// maps iterate names, strings iterate characters
+n = 0
+names = ""
+for k in {a=1 b=2 c=3} {
+    n = n + 1
+    names = names + k
+}
+assert(n == 3)
+n = 0
+for c in names {
+    n = n + 1
+}
+assert(n == 3)
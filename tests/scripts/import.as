@@ -0,0 +1,19 @@
+import "../modules/geometry.as" as geo
+import "../modules/geometry.as"
+
+assert(geo.square(3) == 9)
+assert(geo.cube(2) == 8)
+
+// both names refer to the same module
+geo.unit = 2
+assert(geometry.unit == 2)
+
+f = function() {
+    import "../modules/geometry.as" as g
+    return g.area(2, 5)
+}
+assert(f() == 10)
+
+// the same file through another path is the same module
+import "../scripts/../modules/./geometry.as" as same
+assert(same.unit == 2)
@@ -0,0 +1,47 @@
+sign = function(x) {
+    if x < 0 return -1
+    else if x > 0 return 1
+    return 0
+}
+
+poly = function(x, y) return x*x - 3*y + (x - y) * 2
+
+divmod = function(x, y) return x / y * 100 + x % y
+
+between = function(x, lo, hi) return 1 if x >= lo and x <= hi else 0
+
+nothing = function(x) {
+    if x return 1
+}
+
+i = 0
+sum = 0
+while i < 200 {
+    sum += sign(i - 100) + between(i, 50, 60) + poly(i, 3) % 7 + divmod(i, 7)
+    i += 1
+}
+assert(sum == 276986)
+
+assert(divmod(-17, 5) == -302)
+assert(divmod(9, -1) == -900)
+assert(not between(3, 4, 5))
+assert(sign(0-7) == -1)
+fpoly = poly(2, 1.0)
+assert(nothing(2) == 1)
+none = nothing(0)
+
+// bails inside a right operand, with the left one still on the stack
+nested = function(x, y) return 1 + x / y + x % y
+i = 0
+while i < 200 {
+    assert(nested(i, 3) == 1 + i / 3 + i % 3)
+    i += 1
+}
+assert(nested(9, -1) == -8)
+rem = function(x, y) return x + x % y
+i = 0
+while i < 200 {
+    assert(rem(i, 4) == i + i % 4)
+    i += 1
+}
+assert(rem(9, -1) == 9)
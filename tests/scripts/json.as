@@ -0,0 +1,32 @@
+doc = parseJson('{"name": "probe", "tags": ["a", "b"], "count": 3, "ratio": 0.5, "ok": true, "missing": null}')
+assert(doc.name == "probe")
+assert(doc.tags[1] == "b")
+assert(doc.count == 3)
+assert(doc.ratio == 0.5)
+assert(doc.ok)
+assert(not doc.missing)
+
+// escapes, including a surrogate pair
+s = parseJson('"line\nbreak \"quoted\" \u00e9 \ud83d\ude00"')
+assert(s.length() == 27)
+assert(s.find('"quoted"') == 11)
+
+// large numbers and exponents are floats
+assert(parseJson("3000000000") > 2000000000)
+assert(parseJson("1e2") == 100)
+assert(parseJson(" [ ] ").length() == 0)
+
+// round trip, maps write their names in order
+text = toJson({b = [1, 2.5, "x y"] a = {}})
+assert(text == '{"a":{},"b":[1,2.5,"x y"]}')
+assert(toJson(parseJson(text)) == text)
+assert(toJson(parseJson('"tab\there"')) == '"tab\there"')
+assert(toJson(vec2(1, 2)) == "[1,2]")
+assert(toJson([0..3]) == "[0,1,2,3]")
+
+// streaming calls the function on each element of the top array
+count = 0
+check = function(e) {
+    assert(e.v > 0)
+}
+assert(parseJson('[{"v": 1}, {"v": 2}, {"v": 3}]', check) == 3)
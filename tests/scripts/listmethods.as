@@ -0,0 +1,40 @@
+l = [5, 3, 8, 1]
+
+double = function(x) return x*2
+even = function(x) return x % 2 == 0
+add = function(acc, x) return acc + x
+greater = function(a, b) return a > b
+
+m = l.map(double)
+assert(m.length() == 4)
+assert(m[0] == 10 and m[3] == 2)
+
+f = l.map(double).filter(even)
+assert(f.length() == 4)
+assert(l.filter(even).length() == 1)
+
+assert(l.reduce(add, 0) == 17)
+assert(l.reduce(function(acc, x) return acc*x, 1) == 120)
+
+assert(l.find(8) == 2)
+assert(l.find(7) == -1)
+assert(l.find(even) == 2)
+
+s = l.slice(1, 3)
+assert(s.length() == 2 and s[0] == 3 and s[1] == 8)
+
+l.push(4)
+assert(l.length() == 5 and l[4] == 4)
+assert(l.pop() == 4)
+assert(l.length() == 4)
+
+l.sort()
+assert(l[0] == 1 and l[1] == 3 and l[2] == 5 and l[3] == 8)
+l.sort(greater)
+assert(l[0] == 8 and l[3] == 1)
+l.reverse()
+assert(l[0] == 1 and l[3] == 8)
+
+fl = [2.0, 1, 3.0]
+fl.sort()
+assert(fl[0] == 1 and fl[2] == 3)
@@ -0,0 +1,40 @@
+counter = {
+    n = 0
+    hit = function(v) {
+        this.n = this.n + 1
+        return v
+    }
+}
+
+// right operands are skipped when the left one decides
+x = 0 and counter.hit(1)
+y = 1 or counter.hit(0)
+assert(counter.n == 0)
+assert(x == 0 and y == 1)
+x = 1 and counter.hit(5)
+y = 0 or counter.hit(7)
+assert(counter.n == 2)
+assert(x == 5 and y == 7)
+
+// guard against calling a missing function
+assert(not (0 and missing(1)))
+
+// the value is the operand that decided
+assert((0 or 3) == 3)
+assert((2 and 4) == 4)
+
+// truth of other values
+assert("a" and [1] and {a=1})
+assert(not "")
+assert(not [])
+assert(not {})
+assert(not counter.missing)
+assert(counter and counter.hit)
+
+// loop guard
+l = [1, 2, 3]
+i = 0
+while i < l.length() and l[i] < 3 {
+    i = i+1
+}
+assert(i == 2)
@@ -0,0 +1,31 @@
+// exponential without the cache
+fib = memoize(function(n) {
+    if n < 2 return n
+    return fib(n-1) + fib(n-2)
+})
+assert(fib(40) == 102334155)
+assert(fib.misses() == 41)
+assert(fib(40) == 102334155)
+assert(fib.hits() == 39)
+
+// arguments are keyed by content
+cost = memoize(function(path, weight) return path.length() * weight, 2)
+assert(cost([1, "a", 2.5], 2) == 6)
+assert(cost([1, "a", 2.5], 2) == 6)
+assert(cost.misses() == 1)
+assert(cost([1, "a"], 2) == 4)
+assert(cost([1, "a", 2.5], 3) == 9)
+assert(cost.size() == 2)
+// the least recently used result was dropped
+assert(cost([1, "a"], 2) == 4)
+assert(cost.misses() == 3)
+assert(cost([1, "a", 2.5], 2) == 6)
+assert(cost.misses() == 4)
+
+// maps aren't keys, calls with them always run
+member = memoize(function(m) return m.a)
+assert(member({a = 1}) == 1)
+assert(member({a = 1}) == 1)
+assert(member.misses() == 2)
+cost.clear()
+assert(cost.size() == 0)
@@ -0,0 +1,29 @@
+sum = function(n) {
+    if n == 0 return 0
+    return n + sum(n-1)
+}
+
+// deeper than the native stack given to calls, nested calls continue on new stacks
+assert(sum(5000) == 12502500)
+assert(sum(10) == 55)
+
+count = function(n) {
+    i = 0
+    while i < n {
+        yield i
+        i = i+1
+    }
+}
+
+walk = function(g, n) {
+    if n == 0 {
+        s = 0
+        for x in g {
+            s = s + x
+        }
+        return s
+    }
+    return 0 + walk(g, n-1)
+}
+
+assert(walk(count(100), 3000) == 4950)
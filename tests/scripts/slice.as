@@ -0,0 +1,36 @@
+l = [0, 1, 2, 3, 4, 5, 6, 7, 8, 9]
+
+s = l.slice(2, 8)
+assert(s.length() == 6)
+assert(s[0] == 2 and s[5] == 7)
+
+// slices of slices, with steps
+e = s.slice(0, 6, 2)
+assert(e.length() == 3)
+assert(e[0] == 2 and e[1] == 4 and e[2] == 6)
+n = 0
+for x in e {
+    n = n + x
+}
+assert(n == 12)
+
+// changing either side copies the elements
+s[0] = 100
+assert(l[2] == 2)
+assert(s[0] == 100 and e[0] == 2)
+l[3] = 30
+assert(s[1] == 3 and e[0] == 2)
+e.push(10)
+assert(e.length() == 4 and s.length() == 6)
+
+// divide and conquer over views
+sum = function(l) {
+    if l.length() == 1 return l[0]
+    h = l.length() / 2
+    return sum(l.slice(0, h)) + sum(l.slice(h, l.length()))
+}
+big = []
+for i in [1..1000] {
+    big.push(i)
+}
+assert(sum(big) == 500500)
@@ -0,0 +1,42 @@
+// a table indexed by large ids only stores its elements
+ids = []
+ids[1000000000] = "far"
+assert(ids.length() == 1000000001)
+assert(ids[1000000000] == "far")
+// holes read as None
+assert(not ids[5])
+ids[7] = "near"
+assert(ids[7] == "near")
+assert(toJson(ids.indices()) == "[7,1000000000]")
+ids.push("next")
+assert(ids[1000000001] == "next")
+assert(ids.pop() == "next")
+assert(ids.length() == 1000000001)
+s = ids.slice(999999990, 1000000001)
+assert(s.length() == 11)
+assert(s[10] == "far")
+assert(toJson(s.slice(8, 11)) == '[null,null,"far"]')
+
+// holes of dense lists
+l = [1]
+l[3] = 4
+assert(l.length() == 4)
+assert(not l[2])
+holes = 0
+for e in l {
+    if not e holes = holes+1
+}
+assert(holes == 2)
+assert(toJson(l.indices()) == "[0,3]")
+assert(l.find(function(e) return not e) == 1)
+
+// filling a sparse list makes it dense again
+t = []
+t[100] = 100
+i = 0
+while i < 100 {
+    t[i] = i
+    i = i+1
+}
+assert(t[100] == 100)
+assert(t.reduce(function(a, e) return a + e, 0) == 5050)
@@ -0,0 +1,47 @@
+s = "key=value"
+assert(s.length() == 9)
+assert(s[0] == "k")
+assert(s.find("=") == 3)
+assert(s.find("value") == 4)
+assert(s.find("missing") == -1)
+assert(s.find("e", 2) == 8)
+assert(s.startsWith("key"))
+assert(not s.startsWith("value"))
+assert(s.substr(4) == "value")
+assert(s.substr(0, 3) == "key")
+assert(s.replace("e", "E") == "kEy=valuE")
+
+// comparisons
+assert("abc" < "abd")
+assert("ab" < "abc")
+assert("b" > "abc")
+assert("abc" != "ab")
+assert("" == "")
+
+// parts are views of the line, long enough to share its bytes
+line = "first field is long enough,second field is long enough,3,4.5"
+parts = line.split(",")
+assert(parts.length() == 4)
+assert(parts[0] == "first field is long enough")
+assert(parts[1].substr(7) == "field is long enough")
+assert(parts[2].toInt() + 1 == 4)
+assert(parts[3].toFloat() > 4)
+assert(", ".join(parts) == "first field is long enough, second field is long enough, 3, 4.5")
+assert("-".join([1, "a", 2]) == "1-a-2")
+assert("a,,b,".split(",").length() == 4)
+assert("".split(",")[0] == "")
+
+// search over more than one SSE block
+text = "abcdefghijklmnopqrstuvwxyz"
+text = text + text + text + "needle" + text
+assert(text.find("needle") == 78)
+assert(text.find("needlf") == -1)
+assert(text.find("zab") == 25)
+assert(text.find("zab", 26) == 51)
+assert([1, 2, "x"].find("x") == 2)
+
+n = 0
+for c in "abc" {
+    n += 1
+}
+assert(n == 3)
@@ -0,0 +1,19 @@
+count = function(n, acc) {
+    if n == 0 return acc
+    return count(n-1, acc+1)
+}
+
+assert(count(20000, 0) == 20000)
+
+obj = {
+    n = 0
+    loop = function(n) {
+        while true {
+            if n == 0 return this.n
+            this.n += 1
+            return this.loop(n-1)
+        }
+    }
+}
+
+assert(obj.loop(5000) == 5000)
@@ -0,0 +1,64 @@
+// Functions on ints and floats, compiled to typed code by ascriptc
+
+gcd = function(a, b) {
+    while b != 0 {
+        t = a % b
+        a = b
+        b = t
+    }
+    return a
+}
+
+assert(gcd(1071, 462) == 21)
+
+// recursive calls to the function, tail calls loop
+fact = function(n) return 1 if n < 2 else n * fact(n-1)
+swapsum = function(a, b, n) {
+    if n == 0 return a - b
+    return swapsum(b, a + 1, n - 1)
+}
+
+assert(fact(10) == 3628800)
+assert(swapsum(0, 0, 20000) == 0)
+
+// floats from literals and mixed operations
+mean = function(n) {
+    total = 0.0
+    for i in [1..n] {
+        total += i
+    }
+    return total / n
+}
+
+assert(mean(4) == 2.5)
+
+// a float comparison is a float
+cmp = function(x) return x * 0.5 < 1
+assert(cmp(1) == 1.0)
+
+clamp = function(x, lo, hi) {
+    if x < lo return lo
+    if x > hi return hi
+    return x
+}
+count = function(n) {
+    c = 0
+    i = 0
+    while i < n and c < 1000 {
+        c += clamp(i - 3, 0, 5) or 7
+        i += 1
+    }
+    return c
+}
+
+assert(count(10) == 48)
+
+// calls that can't run natively are interpreted
+half = function(x) {
+    if x % 2 == 0 return x / 2
+}
+
+assert(half(4) == 2)
+assert(not half(3))
+assert(clamp(1.5, 0, 2) == 1.5)
+assert(gcd(7, 0) == 7)
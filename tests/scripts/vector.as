@@ -0,0 +1,36 @@
+a = vec3(1, 2, 3)
+b = vec3(4, 5, 6)
+assert(a.x == 1)
+assert(a.z == 3)
+assert(a[1] == 2)
+
+// componentwise operations
+assert(a + b == vec3(5, 7, 9))
+assert(b - a == vec3(3, 3, 3))
+assert(a * b == vec3(4, 10, 18))
+assert(b / vec3(4, 5, 2) == vec3(1, 1, 3))
+assert(a * 2 == vec3(2, 4, 6))
+assert(2 * a == vec3(2, 4, 6))
+assert(b / 2 == vec3(2, 2.5, 3))
+
+assert(a.dot(b) == 32)
+assert(vec3(1, 0, 0).cross(vec3(0, 1, 0)) == vec3(0, 0, 1))
+assert(vec2(3, 4).length() == 5)
+assert(vec2(3, 4).normalize() == vec2(0.6, 0.8))
+
+// components are assigned in place, vectors are shared like maps
+c = a
+c.x = 10
+assert(a.x == 10)
+a.y += 1
+assert(c.y == 3)
+
+// matrices are column major
+m = mat4()
+v = vec4(1, 2, 3, 1)
+assert(m * v == v)
+t = mat4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 5, 6, 7, 1)
+assert(t * v == vec4(6, 8, 10, 1))
+assert((t * t) * v == vec4(11, 14, 17, 1))
+assert(t[3] == vec4(5, 6, 7, 1))
+assert(t.transpose()[0] == vec4(1, 0, 0, 5))
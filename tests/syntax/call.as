@@ -0,0 +1,3 @@
+// the call is missing its closing parenthesis
+assert(1 == 1
+x = 2
@@ -0,0 +1,3 @@
+// the list is never closed
+l = [1, 2
+assert(l[0] == 1)
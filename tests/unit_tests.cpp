@@ -2,9 +2,17 @@
 #include <iostream>
 #include <experimental/filesystem>
 #include <fstream>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <set>
 
 using namespace std;
 
+struct Vec3 {
+    float x, y, z;
+};
+ASCRIPT_VEC_LAYOUT(Vec3, 3);
 
 int main(void) {
 
@@ -26,19 +34,62 @@ int main(void) {
         }
     }
 
-    ofstream error_log("test_error_log");
+    // Run scripts again with every function compiled on its first call
+    for (auto& de : experimental::filesystem::directory_iterator("tests/scripts")) {
+        auto p = de.path();
+        num_tests += 1;
+        Script script(p);
+        script.setJit(true);
+        script.setJitThreshold(1);
+        try {
+            script.run();
+            passed_tests += 1;
+            cout << "\033[30;42m" << p << " (jit)\033[0m" << endl;
+        } catch (exception &e) {
+            log << e.what() << endl;
+            cout << "\033[30;41m" << p << " (jit)\033[0m" << endl;
+        }
+    }
 
-    for (auto& de : experimental::filesystem::directory_iterator("tests/error")) {
+    // Run scripts again with the closure engine
+    for (auto& de : experimental::filesystem::directory_iterator("tests/scripts")) {
         auto p = de.path();
         num_tests += 1;
         Script script(p);
+        script.setEngine(Script::Engine::Closure);
         try {
             script.run();
-            cout << "\033[30;41m" << p << "\033[0m" << endl;
+            passed_tests += 1;
+            cout << "\033[30;42m" << p << " (closure)\033[0m" << endl;
         } catch (exception &e) {
-            error_log << e.what() << endl;
+            log << e.what() << endl;
+            cout << "\033[30;41m" << p << " (closure)\033[0m" << endl;
+        }
+    }
+
+    ofstream error_log("test_error_log");
+
+    for (auto& de : experimental::filesystem::directory_iterator("tests/error")) {
+        auto p = de.path();
+        num_tests += 1;
+        // Both engines must report the same error
+        string errors[2];
+        for (int i=0;i<2;i++) {
+            Script script(p);
+            if (i == 1) script.setEngine(Script::Engine::Closure);
+            try {
+                script.run();
+            } catch (exception &e) {
+                errors[i] = e.what();
+            }
+        }
+        if (!errors[0].empty() && errors[0] == errors[1]) {
+            error_log << errors[0] << endl;
             passed_tests += 1;
             cout << "\033[30;42m" << p << "\033[0m" << endl;
+        } else {
+            error_log << errors[0] << endl << errors[1] << endl;
+            cout << "\033[30;41m" << p << "\033[0m" << endl;
         }
     }
 
@@ -63,6 +114,491 @@ int main(void) {
     }
     num_tests += 1;
 
+    p = "tests/linking/module.as";
+    Script moduleScript(p);
+    string greeting;
+    moduleScript.link("a", greeting);
+    moduleScript.linkFunction<int(int, int)>("f", f);
+    try {
+        moduleScript.run();
+        if (greeting != "hello world") throw runtime_error("Native module didn't load successfully");
+        passed_tests += 1;
+        cout << "\033[30;42m" << p << "\033[0m" << endl;
+    } catch (exception &e) {
+        log << e.what() << endl;
+        cout << "\033[30;41m" << p << "\033[0m" << endl;
+    }
+    num_tests += 1;
+
+    p = "tests/linking/snapshot.as";
+    try {
+        // Second script starts from the first one's variables
+        int restored = 0;
+        Script first(p);
+        first.link("restored", restored);
+        first.run();
+        first.snapshot("test_snapshot");
+        restored = 1;
+        Script second(p);
+        second.link("restored", restored);
+        second.restore("test_snapshot");
+        second.run();
+        passed_tests += 1;
+        cout << "\033[30;42m" << p << "\033[0m" << endl;
+    } catch (exception &e) {
+        log << e.what() << endl;
+        cout << "\033[30;41m" << p << "\033[0m" << endl;
+    }
+    num_tests += 1;
+
+    p = "tests/linking/batch.as";
+    try {
+        struct Item { int x, y; };
+        vector<Item> items = {{1, 2}, {5, 3}, {7, 7}};
+        vector<int> xs = {1, 5, 7}, ys = {2, 3, 7}, expected = {21, 53, 77};
+        for (int jit=0;jit<2;jit++) {
+            Script script(p);
+            script.setJit(jit);
+            script.setJitThreshold(1);
+            script.run();
+            vector<int> out(3), out2(3);
+            script.callBatch("score", 3, out.data(), xs.data(), ys.data());
+            script.callBatch("score", items.data(), 3, out2.data(), &Item::x, &Item::y);
+            if (out != expected || out2 != expected) throw runtime_error("Wrong batch results");
+            vector<float> vs = {1.5, 2}, ks = {2, 0.5}, fout(2);
+            script.callBatch("scale", 2, fout.data(), vs.data(), ks.data());
+            if (fout[0] != 3 || fout[1] != 1) throw runtime_error("Wrong batch results");
+            auto v = script.call("score", {valp(new ValueInt(4)), valp(new ValueInt(2))});
+            if (v->getInt() != 42) throw runtime_error("Wrong call result");
+        }
+        passed_tests += 1;
+        cout << "\033[30;42m" << p << "\033[0m" << endl;
+    } catch (exception &e) {
+        log << e.what() << endl;
+        cout << "\033[30;41m" << p << "\033[0m" << endl;
+    }
+    num_tests += 1;
+
+    p = "tests/linking/function.as";
+    try {
+        Script script(p);
+        int last = 0;
+        script.link("last", last);
+        script.run();
+        auto add = script.getFunction<int(int, int)>("add");
+        auto half = script.getFunction<float(float)>("half");
+        auto sum = script.getFunction<int(int)>("sum");
+        auto notify = script.getFunction<void(int)>("notify");
+        // script calls back into the handle being called
+        script.linkFunction<int(int)>("again", [&](int n) { return sum(n); });
+        if (add(2, 3) != 5 || add(-1, 1) != 0) throw runtime_error("Wrong function result");
+        if (half(3) != 1.5) throw runtime_error("Wrong function result");
+        if (sum(10) != 55) throw runtime_error("Wrong function result");
+        notify(7);
+        if (last != 7) throw runtime_error("Wrong function result");
+        passed_tests += 1;
+        cout << "\033[30;42m" << p << "\033[0m" << endl;
+    } catch (exception &e) {
+        log << e.what() << endl;
+        cout << "\033[30;41m" << p << "\033[0m" << endl;
+    }
+    num_tests += 1;
+
+    p = "tests/linking/stats.as";
+    try {
+        for (auto engine : {Script::Engine::Tree, Script::Engine::Closure}) {
+            Script script(p);
+            script.setEngine(engine);
+            script.run();
+            auto s = script.stats();
+            if (s.scriptCalls != 10 || s.nativeCalls != 1) throw runtime_error("Wrong call count");
+            if (s.statements < 20 || s.values[ScriptStats::Int] < 20 || s.mapLookups < 30) throw runtime_error("Wrong work count");
+            if (s.heapBytes <= 0 || s.peakHeapBytes < s.heapBytes) throw runtime_error("Wrong heap size");
+            try {
+                script.call("fail", {});
+            } catch (InterpreterError&) {}
+            s = script.stats();
+            if (s.exceptions != 1 || s.scriptCalls != 11) throw runtime_error("Wrong exception count");
+            if (s.dump().find("ascript_calls_total{kind=\"script\"} 11\n") == string::npos) throw runtime_error("Wrong stats dump");
+        }
+        // memoized calls are counted apart
+        Script memo("tests/scripts/memo.as");
+        memo.run();
+        auto s = memo.stats();
+        if (s.memoHits < 39 || s.memoMisses < 41) throw runtime_error("Wrong memoize count");
+        if (s.dump().find("ascript_memo_calls_total{result=\"hit\"}") == string::npos) throw runtime_error("Wrong stats dump");
+        passed_tests += 1;
+        cout << "\033[30;42m" << p << "\033[0m" << endl;
+    } catch (exception &e) {
+        log << e.what() << endl;
+        cout << "\033[30;41m" << p << "\033[0m" << endl;
+    }
+    num_tests += 1;
+
+    p = "tests/linking/trace.as";
+    try {
+        Script script(p);
+        script.setTracing(true);
+        script.run();
+        try {
+            script.call("fail", {});
+        } catch (InterpreterError&) {}
+        stringstream trace;
+        writeChromeTrace(trace);
+        for (string event : {
+            "{\"name\":\"square\",\"cat\":\"script\",\"ph\":\"B\"",
+            "{\"name\":\"area\",\"cat\":\"script\",\"ph\":\"E\"",
+            "{\"name\":\"find\",\"cat\":\"native\",\"ph\":\"B\"",
+            "{\"name\":\"assert\",\"cat\":\"native\",\"ph\":\"E\"",
+            "\"args\":{\"message\":\"Assertion failed\"}",
+        }) {
+            if (trace.str().find(event) == string::npos) throw runtime_error("Missing trace event " + event);
+        }
+        clearTrace();
+        script.setTracing(false);
+        script.call("square", {valp(new ValueInt(2))});
+        trace.str("");
+        writeChromeTrace(trace);
+        if (trace.str().find("square") != string::npos) throw runtime_error("Trace not cleared");
+        passed_tests += 1;
+        cout << "\033[30;42m" << p << "\033[0m" << endl;
+    } catch (exception &e) {
+        log << e.what() << endl;
+        cout << "\033[30;41m" << p << "\033[0m" << endl;
+    }
+    num_tests += 1;
+
+    p = "tests/linking/error.as";
+    try {
+        Script script(p);
+        script.run();
+        bool raised = false;
+        try {
+            script.call("check", {valp(new ValueInt(-1))});
+        } catch (InterpreterError& e) {
+            raised = true;
+            if (e.message() != "Assertion failed" || e.where().line != 2 || e.filename() != p) throw runtime_error("Wrong error");
+            string report = e.what();
+            if (report.find("tests/linking/error.as:2:4:error: Assertion failed\n    assert(x >= 0)\n    ^") != 0) throw runtime_error("Wrong error report " + report);
+        }
+        if (!raised) throw runtime_error("Error not raised");
+        passed_tests += 1;
+        cout << "\033[30;42m" << p << "\033[0m" << endl;
+    } catch (exception &e) {
+        log << e.what() << endl;
+        cout << "\033[30;41m" << p << "\033[0m" << endl;
+    }
+    num_tests += 1;
+
+    p = "tests/linking/vector.as";
+    try {
+        // Host structs of floats are linked as vectors
+        Vec3 position{1, 2, 3}, velocity{1, 1, 1};
+        float transform[16] = {};
+        Script script(p);
+        script.link("position", position);
+        script.link("velocity", velocity);
+        script.link("transform", transform);
+        script.run();
+        if (position.x != 3 || position.y != 0 || position.z != 5) throw runtime_error("Vector not written");
+        if (transform[0] != 1 || transform[1] != 0 || transform[15] != 1) throw runtime_error("Matrix not written");
+        passed_tests += 1;
+        cout << "\033[30;42m" << p << "\033[0m" << endl;
+    } catch (exception &e) {
+        log << e.what() << endl;
+        cout << "\033[30;41m" << p << "\033[0m" << endl;
+    }
+    num_tests += 1;
+
+    p = "tests/linking/channel.as";
+    try {
+        // The script answers on its own thread, values are copied both ways
+        auto requests = make_shared<Channel>(4);
+        auto replies = make_shared<Channel>(4);
+        Script script(p);
+        script.connect("requests", requests);
+        script.connect("replies", replies);
+        string workerError;
+        thread worker([&]() {
+            try {
+                script.run();
+            } catch (exception &e) {
+                workerError = e.what();
+            }
+        });
+        int n = 100;
+        thread sender([&]() {
+            for (int i=0;i<n;i++) {
+                auto r = valp(new ValueMap({}));
+                r->getRef("n") = valp(new ValueInt(i));
+                r->getRef("name") = valp(new ValueStr("item"));
+                requests->send(r);
+            }
+            requests->send(valp(new ValueMap({{"n", valp(new ValueInt(-1))}})));
+        });
+        bool ok = true;
+        for (int i=0;i<n;i++) {
+            auto r = replies->receive();
+            ok &= r->get("n")->getInt() == 2*i;
+            ok &= r->get("tags")->at(0)->getStr() == "item" && r->get("tags")->at(1)->getInt() == 4;
+        }
+        sender.join();
+        worker.join();
+        if (!workerError.empty()) throw runtime_error(workerError);
+        if (!ok) throw runtime_error("Wrong replies");
+        if (replies->tryReceive()) throw runtime_error("Unexpected reply");
+        bool raised = false;
+        try {
+            replies->send(valp(new ValueNativeFunc([](vector<valp>) { return valp(new ValueNone()); })));
+        } catch (runtime_error& e) {
+            raised = true;
+        }
+        if (!raised) throw runtime_error("Function sent");
+        // sparse lists stay sparse
+        auto sparse = make_shared<ValueList>(vallist());
+        sparse->atRef(1000000) = valp(new ValueInt(7));
+        replies->send(sparse);
+        auto copy = dynamic_pointer_cast<ValueList>(replies->receive());
+        if (!copy->isSparse() || copy->size() != 1000001 || copy->at(1000000)->getInt() != 7) throw runtime_error("Sparse list not copied");
+        auto holes = make_shared<ValueList>(vallist());
+        holes->resizeSparse(1000000);
+        replies->send(holes);
+        copy = dynamic_pointer_cast<ValueList>(replies->receive());
+        if (!copy->isSparse() || copy->size() != 1000000) throw runtime_error("List of holes not copied");
+        // host containers convert to script lists and maps
+        vector<valp> hostItems = {valp(new ValueInt(1)), valp(new ValueInt(2))};
+        map<string, valp> hostVars = {{"items", valp(new ValueList(hostItems))}};
+        replies->send(valp(new ValueMap(hostVars)));
+        if (replies->receive()->get("items")->at(1)->getInt() != 2) throw runtime_error("Host containers not converted");
+        // ranges and linked variables are sent by value
+        int linked = 5;
+        auto values = make_shared<ValueList>(vallist{valp(new ValueRange(0, 10, 2)), valp(new ValueExtern<int>(linked))});
+        replies->send(values);
+        linked = 6;
+        auto received = replies->receive();
+        if (received->at(0)->at(2)->getInt() != 4 || received->at(1)->getInt() != 5) throw runtime_error("Values not copied");
+        // a second receiver raises instead of racing with the first one
+        thread receiver([&]() { replies->receive(); });
+        this_thread::sleep_for(chrono::milliseconds(100));
+        raised = false;
+        try {
+            replies->tryReceive();
+        } catch (runtime_error& e) {
+            raised = string(e.what()) == "Channel already has a receiver";
+        }
+        replies->send(valp(new ValueNone()));
+        receiver.join();
+        if (!raised) throw runtime_error("Second receiver allowed");
+        passed_tests += 1;
+        cout << "\033[30;42m" << p << "\033[0m" << endl;
+    } catch (exception &e) {
+        log << e.what() << endl;
+        cout << "\033[30;41m" << p << "\033[0m" << endl;
+    }
+    num_tests += 1;
+
+    p = "tests/linking/memory.as";
+    try {
+        // The script fails with an error at the hard limit, the host is told at the soft one
+        Script script(p);
+        if (script.stats().heapBytes <= 0) throw runtime_error("AST not counted");
+        size_t soft = 1 << 20, hard = 4 << 20;
+        vector<size_t> warnings;
+        script.setMemoryLimits(soft, hard, [&](size_t bytes) { warnings.push_back(bytes); });
+        string error;
+        try {
+            script.run();
+        } catch (InterpreterError& e) {
+            error = e.message();
+        }
+        if (error.find("Out of memory") == string::npos) throw runtime_error("Hard limit not raised");
+        auto s = script.stats();
+        if (warnings.size() != 1 || warnings[0] <= soft) throw runtime_error("Soft limit not reported");
+        if (s.peakHeapBytes > (int64_t)hard || s.heapBytes < (int64_t)soft) throw runtime_error("Wrong heap size");
+        passed_tests += 1;
+        cout << "\033[30;42m" << p << "\033[0m" << endl;
+    } catch (exception &e) {
+        log << e.what() << endl;
+        cout << "\033[30;41m" << p << "\033[0m" << endl;
+    }
+    num_tests += 1;
+
+    p = "tests/syntax";
+    try {
+        // Scripts parsed on several threads run as if loaded one by one
+        vector<string> paths;
+        for (auto& de : experimental::filesystem::directory_iterator("tests/scripts")) paths.push_back(de.path());
+        auto scripts = Script::loadAll(paths, 4);
+        if (scripts.size() != paths.size()) throw runtime_error("Scripts missing");
+        for (auto& s : scripts) s->run();
+        // Errors of every file are raised at once
+        for (auto& de : experimental::filesystem::directory_iterator(p)) paths.push_back(de.path());
+        set<string> failed;
+        try {
+            Script::loadAll(paths, 4);
+        } catch (LoadError& e) {
+            for (auto& error : e.errors()) failed.insert(error.filename());
+        }
+        if (failed.size() != 2) throw runtime_error("Syntax errors not reported");
+        passed_tests += 1;
+        cout << "\033[30;42m" << p << "\033[0m" << endl;
+    } catch (exception &e) {
+        log << e.what() << endl;
+        cout << "\033[30;41m" << p << "\033[0m" << endl;
+    }
+    num_tests += 1;
+
+    p = "tests/linking/views.as";
+    try {
+        // Bytes viewed by a string stay counted until the view is freed
+        Script script(p);
+        script.run();
+        valp part = script.call("part", {});
+        int64_t kept = script.stats().heapBytes;
+        part = nullptr;
+        if (kept - script.stats().heapBytes < 100000) throw runtime_error("Viewed bytes not counted");
+        passed_tests += 1;
+        cout << "\033[30;42m" << p << "\033[0m" << endl;
+    } catch (exception &e) {
+        log << e.what() << endl;
+        cout << "\033[30;41m" << p << "\033[0m" << endl;
+    }
+    num_tests += 1;
+
+    p = "tests/linking/limits.as";
+    try {
+        // Strings are checked against the limit before they are allocated
+        Script script(p);
+        script.run();
+        script.setMemoryLimits(0, 16 << 20);
+        for (string f : {"joined", "replaced", "doubled", "encoded"}) {
+            string error;
+            try {
+                script.call(f, {});
+            } catch (InterpreterError& e) {
+                error = e.message();
+            }
+            if (error.find("Out of memory") == string::npos) throw runtime_error("Limit not raised by " + f);
+        }
+        // so are the blocks of files kept by lines
+        string error;
+        try {
+            script.call("kept", {valp(new ValueStr("test_lines"))});
+        } catch (InterpreterError& e) {
+            error = e.message();
+        }
+        remove("test_lines");
+        if (error.find("Out of memory") == string::npos) throw runtime_error("Limit not raised by kept");
+        passed_tests += 1;
+        cout << "\033[30;42m" << p << "\033[0m" << endl;
+    } catch (exception &e) {
+        log << e.what() << endl;
+        cout << "\033[30;41m" << p << "\033[0m" << endl;
+    }
+    num_tests += 1;
+
+    p = "tests/linking/reload.as";
+    try {
+        // Functions are patched in place, variables and native handles kept
+        auto copy = [](string text) {
+            ofstream("test_reload.as") << text;
+        };
+        stringstream original;
+        original << ifstream(p).rdbuf();
+        for (int engine=0;engine<2;engine++) {
+            copy(original.str());
+            int runs = 0;
+            Script script("test_reload.as");
+            if (engine) script.setEngine(Script::Engine::Closure);
+            script.setJit(true);
+            script.setJitThreshold(1);
+            script.link("runs", runs);
+            script.run();
+            auto step = script.getFunction<int(int)>("step");
+            if (step(3) != 4 || script.call("keep", {valp(new ValueInt(2))})->getInt() != 20) throw runtime_error("Wrong results");
+            string text = original.str();
+            text.replace(text.find("x + 1"), 5, "x + 2");
+            copy("// patched\n" + text + "added = function(x) return x - 1\n");
+            script.reload("test_reload.as");
+            if (runs != 1) throw runtime_error("Script run again");
+            if (step(3) != 5) throw runtime_error("Function not patched");
+            if (script.call("keep", {valp(new ValueInt(2))})->getInt() != 20) throw runtime_error("Unchanged function broken");
+            if (script.call("added", {valp(new ValueInt(3))})->getInt() != 2) throw runtime_error("Added function missing");
+            string removed = text;
+            removed.erase(removed.find("keep = "), removed.find("steps = ") - removed.find("keep = "));
+            copy(removed);
+            script.reload("test_reload.as");
+            if (script.call("keep", {valp(new ValueInt(2))})->getInt() != 20) throw runtime_error("Function of removed definition broken");
+            if (step(3) != 5) throw runtime_error("Function not kept");
+            copy("step = function(x) return x +\n");
+            bool raised = false;
+            try {
+                script.reload("test_reload.as");
+            } catch (LoadError& e) {
+                raised = true;
+            }
+            if (!raised || step(3) != 5) throw runtime_error("Syntax error applied");
+        }
+        remove("test_reload.as");
+        passed_tests += 1;
+        cout << "\033[30;42m" << p << "\033[0m" << endl;
+    } catch (exception &e) {
+        log << e.what() << endl;
+        cout << "\033[30;41m" << p << "\033[0m" << endl;
+    }
+    num_tests += 1;
+
+    p = "tests/linking/generator.as";
+    try {
+        // A suspended generator kept by the host is freed after its script
+        valp g;
+        {
+            Script script(p);
+            script.run();
+            g = script.call("naturals", {});
+            auto gen = dynamic_pointer_cast<ValueGenerator>(g);
+            if (!gen || gen->next()->getInt() != 0 || gen->next()->getInt() != 1) throw runtime_error("Wrong values");
+        }
+        // and raises if resumed then
+        bool raised = false;
+        try {
+            dynamic_pointer_cast<ValueGenerator>(g)->next();
+        } catch (runtime_error& e) {
+            raised = true;
+        }
+        if (!raised) throw runtime_error("Generator resumed after its script");
+        g = nullptr;
+        passed_tests += 1;
+        cout << "\033[30;42m" << p << "\033[0m" << endl;
+    } catch (exception &e) {
+        log << e.what() << endl;
+        cout << "\033[30;41m" << p << "\033[0m" << endl;
+    }
+    num_tests += 1;
+
+    p = "tests/linking/import.as";
+    try {
+        // A module failing to load raises its error on every access
+        Script script(p);
+        script.run();
+        for (int i=0;i<2;i++) {
+            bool raised = false;
+            try {
+                script.call("ready", {});
+            } catch (InterpreterError& e) {
+                raised = true;
+                if (e.message() != "Index out of range") throw runtime_error("Wrong error " + e.message());
+            }
+            if (!raised) throw runtime_error("Half loaded module used");
+        }
+        passed_tests += 1;
+        cout << "\033[30;42m" << p << "\033[0m" << endl;
+    } catch (exception &e) {
+        log << e.what() << endl;
+        cout << "\033[30;41m" << p << "\033[0m" << endl;
+    }
+    num_tests += 1;
+
     cout << passed_tests << "/" << num_tests << " tests passed" << endl;
 
     return passed_tests < num_tests;
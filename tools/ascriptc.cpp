@@ -0,0 +1,697 @@
+#include <ascript/script.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <climits>
+#include <map>
+#include <set>
+
+using namespace std;
+
+// Compiles a script into a C++ translation unit that rebuilds its AST
+// and registers it, so Script(path) runs it without parsing the file.
+// Functions computing on ints and floats are also compiled to typed C++,
+// called in place of interpreting them when their arguments are ints.
+// usage: ascriptc script.as output.cpp
+
+// C++ string literal for s
+string quote(const string& s) {
+    stringstream ss;
+    ss << "\"";
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') ss << "\\" << c;
+        else if (c == '\n') ss << "\\n\"\n\"";
+        else if (c < 32 || c >= 127) {
+            // octal escapes can't absorb following digits
+            ss << "\\" << (char)('0' + (c >> 6)) << (char)('0' + ((c >> 3) & 7)) << (char)('0' + (c & 7));
+        }
+        else ss << c;
+    }
+    ss << "\"";
+    return ss.str();
+}
+
+string info(SourceInfo s) {
+    stringstream ss;
+    ss << "{" << s.line << "u, " << s.column << "u, " << s.start_index << "u, " << s.end_index << "u}";
+    return ss.str();
+}
+
+// Whether function body contains `yield`, see generator.cpp
+bool hasYield(statp body);
+
+enum class Type { Int, Float };
+
+string typeName(Type t) {
+    return t == Type::Int ? "int" : "float";
+}
+
+// Raised when a definition can't be compiled to typed code
+struct Unsupported {};
+
+// Typed code of a function definition
+struct Native {
+    int id;
+    // Parameters are ints, the result type is the type of every return
+    Type result;
+    string signature;
+    string code;
+};
+
+// Functions assigned at the top level of the script, which native code
+// calls directly once it checked that the name still holds them
+map<string, FuncDefExp*> topLevel;
+map<FuncDefExp*, Native> natives;
+
+// Emits the C++ function running definition e on int arguments
+// Every variable is an argument or a local assigned before it is read, with
+// one type. Anything else raises Unsupported and the function is interpreted.
+class NativeEmitter {
+public:
+    /* assumed = result type of recursive calls before the first return */
+    NativeEmitter(FuncDefExp& e, int id, const Type* assumed = nullptr) : e(e), id(id), assumed(assumed) {}
+
+    Native function() {
+        for (auto& a : e.args) {
+            if (a == "this") throw Unsupported();
+            types[a] = Type::Int;
+            assigned.insert(a);
+        }
+        indent = 1;
+        stat(e.body);
+        // falling off the end returns None, let the interpreter do it
+        line("return false;");
+        if (!hasResult) throw Unsupported();
+        string start = tailCalls ? "start:\n" : "";
+        return {id, result, signature(), signature() + " {\n" + declarations() + start + out + "}\n"};
+    }
+
+private:
+    string signature() {
+        string s = "static bool n" + to_string(id) + "(NativeCall& c";
+        for (auto& a : e.args) s += ", int v_" + a;
+        return s + ", " + typeName(result) + "& result)";
+    }
+
+    void line(const string& s) {
+        out += string(4*indent, ' ') + s + "\n";
+    }
+    string tmp() {
+        return "t" + to_string(temps++);
+    }
+    string declarations() {
+        string s;
+        for (auto& t : types) {
+            if (find(e.args.begin(), e.args.end(), t.first) == e.args.end()) {
+                s += "    " + typeName(t.second) + " v_" + t.first + " = 0;\n";
+            }
+        }
+        return s;
+    }
+    // Returns the code emitted by f instead of emitting it
+    template <typename F>
+    string capture(F f) {
+        string saved;
+        swap(out, saved);
+        indent++;
+        f();
+        indent--;
+        swap(out, saved);
+        return saved;
+    }
+    // Sets type of local name, assigned from a value of type t
+    void assign(const string& name, Type t) {
+        if (name == "this") throw Unsupported();
+        auto it = types.find(name);
+        if (it == types.end()) types[name] = t;
+        else if (it->second != t) throw Unsupported();
+        assigned.insert(name);
+    }
+
+    void stat(statp sp) {
+        if (!sp) return;
+        if (auto s = dynamic_pointer_cast<BlockStat>(sp)) {
+            for (auto ss : s->stats) stat(ss);
+        }
+        else if (auto s = dynamic_pointer_cast<AssignStat>(sp)) {
+            auto id = dynamic_pointer_cast<IdExp>(s->left);
+            if (!id) throw Unsupported();
+            Type t;
+            string r = exp(s->right, t);
+            assign(id->name, t);
+            line("v_" + id->name + " = " + r + ";");
+        }
+        else if (auto s = dynamic_pointer_cast<CompAssignStat>(sp)) {
+            auto id = dynamic_pointer_cast<IdExp>(s->left);
+            if (!id) throw Unsupported();
+            Type tr, tl;
+            string r = exp(s->right, tr);
+            string l = exp(s->left, tl);
+            Type t;
+            string v = binop(string(1, s->op[0]), l, tl, r, tr, t);
+            if (t != tl) throw Unsupported();
+            line("v_" + id->name + " = " + v + ";");
+        }
+        else if (auto s = dynamic_pointer_cast<IfStat>(sp)) {
+            Type t;
+            string c = exp(s->cond, t);
+            auto before = assigned;
+            string then = capture([&] { stat(s->then); });
+            auto afterThen = assigned;
+            assigned = before;
+            string els = capture([&] { stat(s->els); });
+            // variables assigned in both branches are assigned after the statement
+            set<string> both;
+            for (auto& n : assigned) if (afterThen.count(n)) both.insert(n);
+            assigned = both;
+            line("if (" + c + " != 0) {");
+            out += then;
+            if (!els.empty()) {
+                line("} else {");
+                out += els;
+            }
+            line("}");
+        }
+        else if (auto s = dynamic_pointer_cast<WhileStat>(sp)) {
+            auto before = assigned;
+            line("while (true) {");
+            string body = capture([&] {
+                Type t;
+                string c = exp(s->cond, t);
+                line("if (" + c + " == 0) break;");
+                stat(s->stat);
+            });
+            out += body;
+            line("}");
+            // the body may not run
+            assigned = before;
+        }
+        else if (auto s = dynamic_pointer_cast<ForStat>(sp)) {
+            // only ranges, `for i in [beg..end..step]`
+            auto r = dynamic_pointer_cast<RangeDefExp>(s->list);
+            if (!r || !r->step) throw Unsupported();
+            Type tb, te, ts;
+            string beg = exp(r->beg, tb), end = exp(r->end, te), step = exp(r->step, ts);
+            if (tb != Type::Int || te != Type::Int || ts != Type::Int) throw Unsupported();
+            string n = tmp(), k = tmp();
+            // a step of 0 raises, a negative length isn't iterated like a range
+            line("if (" + step + " == 0) return false;");
+            line("int " + n + " = (" + end + " - " + beg + ") / " + step + " + 1;");
+            line("if (" + n + " < 0) return false;");
+            auto before = assigned;
+            line("for (int " + k + " = 0; " + k + " < " + n + "; " + k + "++) {");
+            string body = capture([&] {
+                assign(s->id, Type::Int);
+                line("v_" + s->id + " = " + beg + " + " + step + " * " + k + ";");
+                stat(s->stat);
+            });
+            out += body;
+            line("}");
+            assigned = before;
+        }
+        else if (auto s = dynamic_pointer_cast<ReturnStat>(sp)) {
+            if (!s->e) throw Unsupported();
+            if (auto f = dynamic_pointer_cast<FuncCallExp>(s->e)) {
+                // `return f(...)` runs in constant space like in the interpreter,
+                // only recursive ones loop
+                if (callee(*f) != &e) throw Unsupported();
+                vector<string> args;
+                for (auto a : f->a) {
+                    Type ta;
+                    string v = exp(a, ta);
+                    if (ta != Type::Int) throw Unsupported();
+                    // arguments may read the parameters being replaced
+                    args.push_back(tmp());
+                    line("int " + args.back() + " = " + v + ";");
+                }
+                line("if (!NativeCallee::same(c, name" + to_string(id) + ", e" + to_string(id) + ")) return false;");
+                for (int i=0;i<args.size();i++) line("v_" + e.args[i] + " = " + args[i] + ";");
+                line("goto start;");
+                tailCalls = true;
+                return;
+            }
+            Type t;
+            string v = exp(s->e, t);
+            if (!hasResult) {
+                if (assumed && t != *assumed) throw Unsupported();
+                result = t;
+                hasResult = true;
+            } else if (t != result) throw Unsupported();
+            line("result = " + v + ";");
+            line("return true;");
+        }
+        else throw Unsupported();
+    }
+
+    // Emits the statements computing ep, returns the C++ expression of its value
+    string exp(expp ep, Type& t) {
+        if (auto e = dynamic_pointer_cast<IntExp>(ep)) {
+            t = Type::Int;
+            if (e->value == INT_MIN) return "INT_MIN";
+            return e->value < 0 ? "(" + to_string(e->value) + ")" : to_string(e->value);
+        }
+        else if (auto e = dynamic_pointer_cast<FloatExp>(ep)) {
+            // infinities and NaN have no literal
+            if (!(e->value - e->value == 0)) throw Unsupported();
+            t = Type::Float;
+            stringstream ss;
+            ss.precision(9);
+            ss << showpoint << e->value;
+            return "(" + ss.str() + "f)";
+        }
+        else if (auto e = dynamic_pointer_cast<IdExp>(ep)) {
+            if (!assigned.count(e->name)) throw Unsupported();
+            t = types[e->name];
+            return "v_" + e->name;
+        }
+        else if (auto e = dynamic_pointer_cast<UnOpExp>(ep)) {
+            string l = exp(e->l, t);
+            string r = tmp();
+            if (e->op == "-") {
+                if (t == Type::Int) line("int " + r + " = (int)(0u - (unsigned)" + l + ");");
+                else line("float " + r + " = -" + l + ";");
+            }
+            else if (e->op == "not") line(typeName(t) + " " + r + " = " + l + " == 0;");
+            else throw Unsupported();
+            return r;
+        }
+        else if (auto e = dynamic_pointer_cast<BinOpExp>(ep)) {
+            Type tl, tr;
+            string l = exp(e->l, tl);
+            string r = exp(e->r, tr);
+            return binop(e->op, l, tl, r, tr, t);
+        }
+        else if (auto e = dynamic_pointer_cast<AndExp>(ep)) {
+            return logic(e->l, e->r, "!= 0", t);
+        }
+        else if (auto e = dynamic_pointer_cast<OrExp>(ep)) {
+            return logic(e->l, e->r, "== 0", t);
+        }
+        else if (auto e = dynamic_pointer_cast<TernaryExp>(ep)) {
+            Type tc, tt, te;
+            string c = exp(e->cond, tc);
+            string vt, ve;
+            string then = capture([&] { vt = exp(e->then, tt); });
+            string els = capture([&] { ve = exp(e->els, te); });
+            if (tt != te) throw Unsupported();
+            t = tt;
+            string r = tmp();
+            line(typeName(t) + " " + r + ";");
+            line("if (" + c + " != 0) {");
+            out += then;
+            line("    " + r + " = " + vt + ";");
+            line("} else {");
+            out += els;
+            line("    " + r + " = " + ve + ";");
+            line("}");
+            return r;
+        }
+        else if (auto e = dynamic_pointer_cast<FuncCallExp>(ep)) {
+            return call(*e, t);
+        }
+        else throw Unsupported();
+    }
+
+    string binop(const string& op, string l, Type tl, string r, Type tr, Type& t) {
+        string v = tmp();
+        if (tl == Type::Int && tr == Type::Int) {
+            t = Type::Int;
+            if (op == "+" || op == "-" || op == "*") {
+                // wraps like the interpreter on overflow
+                line("int " + v + " = (int)((unsigned)" + l + " " + op + " (unsigned)" + r + ");");
+            }
+            else if (op == "/" || op == "%") {
+                line("if (" + r + " == 0 || (" + r + " == -1 && " + l + " == INT_MIN)) return false;");
+                line("int " + v + " = " + l + " " + op + " " + r + ";");
+            }
+            else if (op == "==" || op == "!=" || op == "<" || op == "<=" || op == ">" || op == ">=") {
+                line("int " + v + " = " + l + " " + op + " " + r + ";");
+            }
+            else throw Unsupported();
+            return v;
+        }
+        // mixed operands are floats
+        t = Type::Float;
+        if (tl == Type::Int) l = "(float)" + l;
+        if (tr == Type::Int) r = "(float)" + r;
+        if (op == "+" || op == "-" || op == "*" || op == "/") {
+            line("float " + v + " = " + l + " " + op + " " + r + ";");
+        }
+        else if (op == "%") {
+            string d = tmp();
+            line("int " + d + " = (int)" + r + ";");
+            line("if (" + d + " == 0 || (" + d + " == -1 && (int)" + l + " == INT_MIN)) return false;");
+            line("float " + v + " = (float)((int)" + l + " % " + d + ");");
+        }
+        else if (op == "==" || op == "!=" || op == "<" || op == "<=" || op == ">" || op == ">=") {
+            line("float " + v + " = " + l + " " + op + " " + r + ";");
+        }
+        else throw Unsupported();
+        return v;
+    }
+
+    // `and` keeps l unless it is true, `or` unless it is false
+    string logic(expp le, expp re, const string& test, Type& t) {
+        string l = exp(le, t);
+        string v = tmp();
+        line(typeName(t) + " " + v + " = " + l + ";");
+        Type tr;
+        auto before = assigned;
+        string r;
+        string code = capture([&] { r = exp(re, tr); });
+        assigned = before;
+        if (tr != t) throw Unsupported();
+        line("if (" + v + " " + test + ") {");
+        out += code;
+        line("    " + v + " = " + r + ";");
+        line("}");
+        return v;
+    }
+
+    // Top level definition called by f
+    FuncDefExp* callee(const FuncCallExp& f) {
+        if (f.ctx || types.count(f.f) || f.f == "this") throw Unsupported();
+        auto it = topLevel.find(f.f);
+        if (it == topLevel.end() || it->second->args.size() != f.a.size()) throw Unsupported();
+        return it->second;
+    }
+
+    // Calls a function of the top level that is compiled
+    string call(const FuncCallExp& f, Type& t) {
+        FuncDefExp* callee = this->callee(f);
+        int calleeId;
+        if (callee == &e) {
+            // recursive calls need a return before them to know the result type
+            if (hasResult) t = result;
+            else if (assumed) t = *assumed;
+            else throw Unsupported();
+            calleeId = id;
+        } else {
+            auto n = natives.find(callee);
+            if (n == natives.end()) throw Unsupported();
+            calleeId = n->second.id;
+            t = n->second.result;
+        }
+        string args;
+        for (auto a : f.a) {
+            Type ta;
+            args += ", " + exp(a, ta);
+            if (ta != Type::Int) throw Unsupported();
+        }
+        string r = tmp(), id = to_string(calleeId);
+        line(typeName(t) + " " + r + ";");
+        line("if (!nativeCall(c, name" + id + ", e" + id + ", n" + id + ", " + r + args + ")) return false;");
+        return r;
+    }
+
+    FuncDefExp& e;
+    int id;
+    const Type* assumed;
+    map<string, Type> types;
+    // Variables assigned on every path to the code being emitted
+    set<string> assigned;
+    Type result = Type::Int;
+    bool hasResult = false;
+    bool tailCalls = false;
+    string out;
+    int indent = 0;
+    int temps = 0;
+};
+
+void collect(statp sp, vector<FuncDefExp*>& defs);
+
+void collect(expp ep, vector<FuncDefExp*>& defs) {
+    if (!ep) return;
+    if (auto e = dynamic_pointer_cast<BinOpExp>(ep)) { collect(e->l, defs); collect(e->r, defs); }
+    else if (auto e = dynamic_pointer_cast<UnOpExp>(ep)) collect(e->l, defs);
+    else if (auto e = dynamic_pointer_cast<MapDefExp>(ep)) { for (auto& v : e->values) collect(v.second, defs); }
+    else if (auto e = dynamic_pointer_cast<ListDefExp>(ep)) { for (auto& v : e->values) collect(v, defs); }
+    else if (auto e = dynamic_pointer_cast<RangeDefExp>(ep)) { collect(e->beg, defs); collect(e->end, defs); collect(e->step, defs); }
+    else if (auto e = dynamic_pointer_cast<FuncCallExp>(ep)) { collect(e->ctx, defs); for (auto& a : e->a) collect(a, defs); }
+    else if (auto e = dynamic_pointer_cast<FuncDefExp>(ep)) { defs.push_back(e.get()); collect(e->body, defs); }
+    else if (auto e = dynamic_pointer_cast<IndexExp>(ep)) { collect(e->l, defs); collect(e->i, defs); }
+    else if (auto e = dynamic_pointer_cast<MemberExp>(ep)) collect(e->l, defs);
+    else if (auto e = dynamic_pointer_cast<TernaryExp>(ep)) { collect(e->cond, defs); collect(e->then, defs); collect(e->els, defs); }
+    else if (auto e = dynamic_pointer_cast<AndExp>(ep)) { collect(e->l, defs); collect(e->r, defs); }
+    else if (auto e = dynamic_pointer_cast<OrExp>(ep)) { collect(e->l, defs); collect(e->r, defs); }
+}
+
+// Lists the function definitions of the script
+void collect(statp sp, vector<FuncDefExp*>& defs) {
+    if (!sp) return;
+    if (auto s = dynamic_pointer_cast<AssignStat>(sp)) { collect(s->left, defs); collect(s->right, defs); }
+    else if (auto s = dynamic_pointer_cast<CompAssignStat>(sp)) { collect(s->left, defs); collect(s->right, defs); }
+    else if (auto s = dynamic_pointer_cast<FuncCallStat>(sp)) { collect(s->ctx, defs); for (auto& a : s->a) collect(a, defs); }
+    else if (auto s = dynamic_pointer_cast<IfStat>(sp)) { collect(s->cond, defs); collect(s->then, defs); collect(s->els, defs); }
+    else if (auto s = dynamic_pointer_cast<BlockStat>(sp)) { for (auto& ss : s->stats) collect(ss, defs); }
+    else if (auto s = dynamic_pointer_cast<WhileStat>(sp)) { collect(s->cond, defs); collect(s->stat, defs); }
+    else if (auto s = dynamic_pointer_cast<ForStat>(sp)) { collect(s->list, defs); collect(s->stat, defs); }
+    else if (auto s = dynamic_pointer_cast<ReturnStat>(sp)) collect(s->e, defs);
+    else if (auto s = dynamic_pointer_cast<YieldStat>(sp)) collect(s->e, defs);
+}
+
+// Compiles the functions of code that can be typed, returns their C++ code
+string compileNatives(statp code) {
+    vector<FuncDefExp*> defs;
+    collect(code, defs);
+    // names assigned more than once at the top level aren't called directly
+    set<string> ambiguous;
+    if (auto b = dynamic_pointer_cast<BlockStat>(code)) {
+        for (auto& s : b->stats) {
+            auto a = dynamic_pointer_cast<AssignStat>(s);
+            auto id = a ? dynamic_pointer_cast<IdExp>(a->left) : nullptr;
+            if (!id) continue;
+            auto e = dynamic_pointer_cast<FuncDefExp>(a->right);
+            if (!e || topLevel.count(id->name)) ambiguous.insert(id->name);
+            else topLevel[id->name] = e.get();
+        }
+    }
+    for (auto& n : ambiguous) topLevel.erase(n);
+    // functions calling others compile once the result type of these is known
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (int i=0;i<defs.size();i++) {
+            if (natives.count(defs[i]) || hasYield(defs[i]->body)) continue;
+            // recursive calls before a return are typed by trying both types
+            Type types[] = {Type::Int, Type::Float};
+            const Type* assumptions[] = {nullptr, &types[0], &types[1]};
+            for (auto assumed : assumptions) {
+                try {
+                    natives[defs[i]] = NativeEmitter(*defs[i], i, assumed).function();
+                    progress = true;
+                    break;
+                } catch (Unsupported) {}
+            }
+        }
+    }
+
+    string out;
+    for (auto& d : topLevel) {
+        if (!natives.count(d.second)) continue;
+        out += "static const string name" + to_string(natives[d.second].id) + " = " + quote(d.first) + ";\n";
+    }
+    for (auto& n : natives) {
+        string id = to_string(n.second.id);
+        out += n.second.signature + ";\n";
+        out += "static bool e" + id + "(NativeCall& c, const vector<valp>& args, valp& result);\n";
+    }
+    for (auto& n : natives) {
+        auto& args = n.first->args;
+        string id = to_string(n.second.id);
+        out += "\n" + n.second.code + "\n";
+        // entry called by the interpreter, runs when the arguments are ints
+        out += "static bool e" + id + "(NativeCall& c, const vector<valp>& args, valp& result) {\n";
+        string call;
+        if (!args.empty()) {
+            out += "    int";
+            for (int i=0;i<args.size();i++) out += string(i ? "," : "") + " a" + to_string(i);
+            out += ";\n";
+        }
+        out += "    if (args.size() != " + to_string(args.size());
+        for (int i=0;i<args.size();i++) {
+            out += " || !nativeArg(args[" + to_string(i) + "], a" + to_string(i) + ")";
+            call += ", a" + to_string(i);
+        }
+        out += ") return false;\n";
+        out += "    " + typeName(n.second.result) + " r;\n";
+        out += "    if (!n" + id + "(c" + call + ", r)) return false;\n";
+        out += "    result = nativeValue(r);\n";
+        out += "    return true;\n";
+        out += "}\n";
+    }
+    return out;
+}
+
+string gen(expp ep);
+string gen(statp sp);
+
+string gen(expl l) {
+    string s = "expl{";
+    for (int i=0;i<l.size();i++) {
+        if (i > 0) s += ", ";
+        s += gen(l[i]);
+    }
+    return s + "}";
+}
+
+string gen(vector<string> ids) {
+    string s = "vector<string>{";
+    for (int i=0;i<ids.size();i++) {
+        if (i > 0) s += ", ";
+        s += quote(ids[i]);
+    }
+    return s + "}";
+}
+
+string gen(statp sp) {
+    if (!sp) return "nullptr";
+    string n = "node";
+    string i = info(sp->srcinfo);
+    if (auto s = dynamic_pointer_cast<AssignStat>(sp)) {
+        return n + "<AssignStat>(" + i + ", " + gen(s->left) + ", " + gen(s->right) + ")";
+    }
+    else if (auto s = dynamic_pointer_cast<CompAssignStat>(sp)) {
+        return n + "<CompAssignStat>(" + i + ", " + gen(s->left) + ", " + gen(s->right) + ", " + quote(s->op) + ")";
+    }
+    else if (auto s = dynamic_pointer_cast<FuncCallStat>(sp)) {
+        return n + "<FuncCallStat>(" + i + ", " + gen(s->ctx) + ", " + quote(s->f) + ", " + gen(s->a) + ")";
+    }
+    else if (auto s = dynamic_pointer_cast<IfStat>(sp)) {
+        return n + "<IfStat>(" + i + ", " + gen(s->cond) + ", " + gen(s->then) + ", " + gen(s->els) + ")";
+    }
+    else if (auto s = dynamic_pointer_cast<BlockStat>(sp)) {
+        string r = n + "<BlockStat>(" + i + ", vector<statp>{";
+        for (int j=0;j<s->stats.size();j++) {
+            if (j > 0) r += ",";
+            r += "\n" + gen(s->stats[j]);
+        }
+        return r + "})";
+    }
+    else if (auto s = dynamic_pointer_cast<WhileStat>(sp)) {
+        return n + "<WhileStat>(" + i + ", " + gen(s->cond) + ", " + gen(s->stat) + ")";
+    }
+    else if (auto s = dynamic_pointer_cast<ForStat>(sp)) {
+        return n + "<ForStat>(" + i + ", " + quote(s->id) + ", " + gen(s->list) + ", " + gen(s->stat) + ")";
+    }
+    else if (auto s = dynamic_pointer_cast<ReturnStat>(sp)) {
+        return n + "<ReturnStat>(" + i + ", " + gen(s->e) + ")";
+    }
+    else if (auto s = dynamic_pointer_cast<YieldStat>(sp)) {
+        return n + "<YieldStat>(" + i + ", " + gen(s->e) + ")";
+    }
+    else if (auto s = dynamic_pointer_cast<ImportStat>(sp)) {
+        return n + "<ImportStat>(" + i + ", " + quote(s->path) + ", " + quote(s->name) + ")";
+    }
+    else throw runtime_error("Unknown statement");
+}
+
+string gen(expp ep) {
+    if (!ep) return "(expp)nullptr";
+    string n = "node";
+    string i = info(ep->srcinfo);
+    if (auto e = dynamic_pointer_cast<IntExp>(ep)) {
+        return n + "<IntExp>(" + i + ", " + to_string(e->value) + ")";
+    }
+    else if (auto e = dynamic_pointer_cast<FloatExp>(ep)) {
+        stringstream ss;
+        ss.precision(9);
+        ss << e->value;
+        return n + "<FloatExp>(" + i + ", " + ss.str() + ")";
+    }
+    else if (auto e = dynamic_pointer_cast<IdExp>(ep)) {
+        return n + "<IdExp>(" + i + ", " + quote(e->name) + ")";
+    }
+    else if (auto e = dynamic_pointer_cast<BinOpExp>(ep)) {
+        return n + "<BinOpExp>(" + i + ", " + quote(e->op) + ", " + gen(e->l) + ", " + gen(e->r) + ")";
+    }
+    else if (auto e = dynamic_pointer_cast<UnOpExp>(ep)) {
+        return n + "<UnOpExp>(" + i + ", " + quote(e->op) + ", " + gen(e->l) + ")";
+    }
+    else if (auto e = dynamic_pointer_cast<MapDefExp>(ep)) {
+        string r = n + "<MapDefExp>(" + i + ", map<string, expp>{";
+        bool first = true;
+        for (auto f : e->values) {
+            if (!first) r += ", ";
+            first = false;
+            r += "{" + quote(f.first) + ", " + gen(f.second) + "}";
+        }
+        return r + "})";
+    }
+    else if (auto e = dynamic_pointer_cast<ListDefExp>(ep)) {
+        return n + "<ListDefExp>(" + i + ", " + gen(e->values) + ")";
+    }
+    else if (auto e = dynamic_pointer_cast<RangeDefExp>(ep)) {
+        return n + "<RangeDefExp>(" + i + ", " + gen(e->beg) + ", " + gen(e->end) + ", " + gen(e->step) + ")";
+    }
+    else if (auto e = dynamic_pointer_cast<FuncCallExp>(ep)) {
+        return n + "<FuncCallExp>(" + i + ", " + gen(e->ctx) + ", " + quote(e->f) + ", " + gen(e->a) + ")";
+    }
+    else if (auto e = dynamic_pointer_cast<FuncDefExp>(ep)) {
+        string def = n + "<FuncDefExp>(" + i + ", " + gen(e->args) + ", " + gen(e->body) + ", " + quote(e->name) + ")";
+        auto it = natives.find(e.get());
+        if (it == natives.end()) return def;
+        return "nativeNode(" + def + ", e" + to_string(it->second.id) + ")";
+    }
+    else if (auto e = dynamic_pointer_cast<StrExp>(ep)) {
+        return n + "<StrExp>(" + i + ", " + quote(e->v) + ")";
+    }
+    else if (auto e = dynamic_pointer_cast<IndexExp>(ep)) {
+        return n + "<IndexExp>(" + i + ", " + gen(e->l) + ", " + gen(e->i) + ")";
+    }
+    else if (auto e = dynamic_pointer_cast<MemberExp>(ep)) {
+        return n + "<MemberExp>(" + i + ", " + gen(e->l) + ", " + quote(e->member) + ")";
+    }
+    else if (auto e = dynamic_pointer_cast<TernaryExp>(ep)) {
+        return n + "<TernaryExp>(" + i + ", " + gen(e->cond) + ", " + gen(e->then) + ", " + gen(e->els) + ")";
+    }
+    else if (auto e = dynamic_pointer_cast<AndExp>(ep)) {
+        return n + "<AndExp>(" + i + ", " + gen(e->l) + ", " + gen(e->r) + ")";
+    }
+    else if (auto e = dynamic_pointer_cast<OrExp>(ep)) {
+        return n + "<OrExp>(" + i + ", " + gen(e->l) + ", " + gen(e->r) + ")";
+    }
+    else throw runtime_error("Unknown expression");
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        cerr << "usage: " << argv[0] << " script.as output.cpp" << endl;
+        return 1;
+    }
+    string path = argv[1];
+    ifstream stream(path);
+    if (!stream) {
+        cerr << "Can't open " << path << endl;
+        return 1;
+    }
+    stringstream ss;
+    ss << stream.rdbuf();
+    string source = ss.str();
+
+    ofstream out(argv[2]);
+    try {
+        statp code = parse(make_shared<Source>(path, source));
+        out << "// Generated by ascriptc from " << path << endl;
+        out << "#include <ascript/compiled.h>" << endl << endl;
+        out << "using namespace std;" << endl << endl;
+        out << compileNatives(code) << endl;
+        out << "static statp build() {" << endl;
+        out << "return " << gen(code) << ";" << endl;
+        out << "}" << endl << endl;
+        out << "static const CompiledScript script = {" << endl;
+        out << quote(path) << "," << endl;
+        out << quote(source) << "," << endl;
+        out << "build" << endl;
+        out << "};" << endl << endl;
+        out << "static bool registered = registerCompiledScript(&script);" << endl;
+    } catch (LoadError &e) {
+        cerr << e.what();
+        return 1;
+    } catch (exception &e) {
+        cerr << path << ": " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}